@@ -1,2 +1,4 @@
 from ._agent import Engine
-from ._agent import Train
\ No newline at end of file
+from ._agent import Train
+from ._agent import VecEngine
+from ._agent import Policy
@@ -0,0 +1,413 @@
+/*!
+ *  @file bench.cpp
+ *  @brief Micro-benchmarks of the engine and trainer hot paths.
+ *
+ *  Built by `make` with L2S_HEADLESS. Every benchmark reports nanoseconds
+ *  and heap allocations per operation, for grid sizes 10/20/40/80 and, where
+ *  the snake length matters, a 3-cell snake and one filling half the board.
+ *
+ *    l2s_bench                     print the results
+ *    l2s_bench --json FILE         also write them as a baseline
+ *    l2s_bench --compare FILE      compare with a baseline, exit 1 on regression
+ *
+ *  The benchmarks run in --repeats rounds, each timing one sample of every
+ *  benchmark, so a burst of machine noise hits a few samples rather than all
+ *  of one benchmark. The median sample is reported and its gap to the
+ *  fastest one is kept as the noise of the benchmark ("spread").
+ *  A result regresses when it is slower than the baseline by more than
+ *  --threshold (default 0.15) or twice the summed spreads, whichever is
+ *  larger, or when it allocates more. Baselines are machine specific.
+ */
+
+#include "include/train.hpp"
+#include "include/state.hpp"
+#include "include/qtable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+
+// ---------- allocation counting ----------
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // new / delete below pair malloc / free
+#endif
+
+static std::atomic<long long> alloc_count{0}; ///< Calls to operator new so far.
+
+void* operator new(size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+
+// ---------- timing ----------
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    int grid;
+    int length;  ///< Snake length, 0 when it does not apply.
+    double ns;     ///< Nanoseconds per operation, median sample.
+    double allocs; ///< Heap allocations per operation.
+    double spread; ///< Median sample / fastest sample - 1: the timing noise.
+    std::vector<double> samples; ///< Nanoseconds per operation of each round.
+    long long ops;               ///< Operations timed over all rounds.
+};
+
+static double min_time = 0.2; ///< Seconds of timed work per benchmark.
+static int repeats = 9;       ///< Rounds, i.e. timed samples per benchmark.
+static std::vector<Result> results;
+static const char* filter = nullptr;
+
+/**
+ * @brief Time one sample of `batch(ops)`, about min_time / repeats seconds.
+ *
+ * `setup()` runs before each batch, outside the timed region; `batch()` must
+ * perform `ops` operations and is timed as a whole. A sample holds at least
+ * one batch; when setup dominates, it stops after 5 times its share of wall
+ * time. main() calls every benchmark once per round, so the samples of one
+ * benchmark are spread over the whole run rather than taken back to back and
+ * a burst of machine noise spoils only some of them.
+ */
+template <typename Setup, typename Batch>
+static void bench(const std::string& name, int grid, int length, int ops, Setup setup, Batch batch) {
+    if (filter && name.find(filter) == std::string::npos) return;
+
+    Result* r = nullptr;
+    for (Result& c : results) {
+        if (c.name == name && c.grid == grid && c.length == length) r = &c;
+    }
+    if (!r) {
+        results.push_back({name, grid, length, 0.0, 0.0, 0.0, {}, 0});
+        r = &results.back();
+    }
+
+    setup();
+    batch(); // warm up
+    const double slice = min_time / repeats;
+    const auto start = Clock::now();
+    double elapsed = 0.0;
+    long long sample_ops = 0, allocs = 0;
+    while (sample_ops == 0 || (elapsed < slice
+                               && std::chrono::duration<double>(Clock::now() - start).count() < 5 * slice)) {
+        setup();
+        const long long a0 = alloc_count.load(std::memory_order_relaxed);
+        const auto t0 = Clock::now();
+        batch();
+        const auto t1 = Clock::now();
+        allocs += alloc_count.load(std::memory_order_relaxed) - a0;
+        elapsed += std::chrono::duration<double>(t1 - t0).count();
+        sample_ops += ops;
+    }
+    r->samples.push_back(elapsed * 1e9 / sample_ops);
+    r->allocs += allocs;
+    r->ops += sample_ops;
+}
+
+/**
+ * @brief Reduce the samples of each result and print it.
+ *
+ * The median ignores both the samples slowed down by the machine and the
+ * occasional lucky one; its distance to the fastest tells how noisy they were.
+ */
+static void finish() {
+    for (Result& r : results) {
+        std::vector<double> s = r.samples;
+        std::sort(s.begin(), s.end());
+        r.ns = s[s.size() / 2];
+        r.spread = s.front() > 0 ? r.ns / s.front() - 1.0 : 0.0;
+        r.allocs /= r.ops;
+        printf("%-16s grid %-3d len %-5d %12.1f ns/op +-%5.1f%% %8.2f allocs/op\n",
+               r.name.c_str(), r.grid, r.length, r.ns, r.spread * 100.0, r.allocs);
+    }
+    fflush(stdout);
+}
+
+
+// ---------- board setups ----------
+
+enum Ahead { AHEAD_EMPTY, AHEAD_GREEN, AHEAD_RED };
+
+/**
+ * @brief Cell `k` of a path snaking through the board row by row.
+ */
+static std::pair<int,int> path_cell(int grid, int k) {
+    const int y = k / grid;
+    const int x = (y % 2 == 0) ? k % grid : grid - 1 - k % grid;
+    return {x, y};
+}
+
+/**
+ * @brief Lay a snake of `length` cells along path_cell(), head first, with
+ *        `ahead` on the next path cell and the other apples at the path end.
+ *
+ * The head moves along the path, so the next step_forward() takes the
+ * normal, grow or shrink branch depending on `ahead`.
+ */
+static void layout(Engine& e, int grid, int length, Ahead ahead) {
+    e.reset_board(grid);
+    for (int i = 0; i < (int)e.snake.size(); ++i) {
+        e.vacate(CELL_SNAKE, e.snake[i].first, e.snake[i].second);
+    }
+    for (const auto& g : e.greens) e.vacate(CELL_GREEN, g.first, g.second);
+    if (e.red.first >= 0) e.vacate(CELL_RED, e.red.first, e.red.second);
+    e.snake.reset(grid * grid);
+    e.greens.clear();
+    e.red = {-1, -1};
+
+    for (int k = length - 1; k >= 0; --k) {
+        const auto c = path_cell(grid, k);
+        e.snake.push_back(c);
+        e.occupy(k == length - 1 ? CELL_HEAD : CELL_SNAKE, c.first, c.second);
+    }
+
+    int last = grid * grid - 1;
+    auto place = [&](CellCode code, std::pair<int,int> c) {
+        if (code == CELL_GREEN) e.greens.push_back(c);
+        else e.red = c;
+        e.occupy(code, c.first, c.second);
+    };
+    const auto next = path_cell(grid, length);
+    int greens = 2, reds = 1;
+    if (ahead == AHEAD_GREEN) { place(CELL_GREEN, next); --greens; }
+    if (ahead == AHEAD_RED) { place(CELL_RED, next); --reds; }
+    for (; greens > 0; --greens) place(CELL_GREEN, path_cell(grid, last--));
+    for (; reds > 0; --reds) place(CELL_RED, path_cell(grid, last--));
+
+    const auto head = e.snake.front();
+    if (next.second > head.second) e.head_dir = Dir::DOWN;
+    else e.head_dir = next.first > head.first ? Dir::RIGHT : Dir::LEFT;
+    e.zobrist = e.compute_zobrist(); // the board was rebuilt outside the move code
+}
+
+
+// ---------- benchmarks ----------
+
+static void bench_grid(int grid) {
+    const int BATCH = 64;
+    std::vector<Engine> envs(BATCH);
+    Engine tmpl;
+
+    bench("reset_board", grid, 0, BATCH,
+          [] {},
+          [&] { for (Engine& e : envs) e.reset_board(grid); });
+
+    const int area = grid * grid;
+    for (int length : {3, area / 2}) {
+        struct Branch { const char* name; Ahead ahead; };
+        for (Branch br : {Branch{"step_normal", AHEAD_EMPTY}, Branch{"step_grow", AHEAD_GREEN},
+                          Branch{"step_shrink", AHEAD_RED}}) {
+            layout(tmpl, grid, length, br.ahead);
+            bench(br.name, grid, length, BATCH,
+                  [&] { for (Engine& e : envs) e = tmpl; },
+                  [&] { for (Engine& e : envs) e.step_forward(false); });
+        }
+
+        layout(tmpl, grid, length, AHEAD_EMPTY);
+        Engine& e = tmpl;
+        volatile size_t sink = 0;
+        bench("head_vision", grid, length, BATCH, [] {},
+              [&] { for (int i = 0; i < BATCH; ++i) sink = sink + e.get_head_vision()[0].size(); });
+        bench("state_vision", grid, length, BATCH, [] {},
+              [&] { for (int i = 0; i < BATCH; ++i) sink = sink + State(e.get_head_vision()).index(); });
+        bench("state_sensors", grid, length, BATCH, [] {},
+              [&] { for (int i = 0; i < BATCH; ++i) sink = sink + State::from_engine(e).index(); });
+
+        EngineSnapshot snap;
+        bench("snapshot", grid, length, BATCH, [] {},
+              [&] { for (int i = 0; i < BATCH; ++i) e.snapshot(snap); });
+        bench("restore", grid, length, BATCH, [] {},
+              [&] { for (int i = 0; i < BATCH; ++i) e.restore(snap); });
+        bench("make_unmake", grid, length, BATCH, [] {},
+              [&] { for (int i = 0; i < BATCH; ++i) e.unmake_move(e.make_move(-1)); }); // -1: keep going
+    }
+
+    TrainConfig cfg;
+    cfg.grid = grid;
+    cfg.episodes = 20;
+    cfg.eps_start = cfg.eps_end = 0.1; // same exploration in every batch
+    cfg.quiet = true;
+    QTable Q;
+    bench("train_episode", grid, 0, cfg.episodes, [] {},
+          [&] { TrainProgress progress; train_logic(Q, cfg, progress); });
+}
+
+static void bench_tables() {
+    const int BATCH = 4096;
+    std::mt19937 gen(42);
+    QTable Q;
+    std::vector<uint32_t> idx(BATCH);
+    for (uint32_t& i : idx) {
+        i = gen() % State::COUNT;
+        Q.store(i, gen() % 4, (int)(gen() % 100) - 50);
+    }
+    std::vector<QValues> qs(BATCH);
+    for (QValues& q : qs) {
+        for (int& v : q) v = (int)(gen() % 5) - 2; // small range: many ties
+    }
+    volatile long long sink = 0;
+
+    bench("qref", 0, 0, BATCH, [] {},
+          [&] { long long s = 0; for (uint32_t i : idx) s += Q.load(i)[0]; sink = s; });
+    bench("argmax4_random", 0, 0, BATCH, [] {},
+          [&] { long long s = 0; for (const QValues& q : qs) s += argmax4(q, TIE_RANDOM); sink = s; });
+    bench("argmax4_first", 0, 0, BATCH, [] {},
+          [&] { long long s = 0; for (const QValues& q : qs) s += argmax4(q, TIE_FIRST); sink = s; });
+}
+
+
+// ---------- baselines ----------
+
+static bool write_json(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        fprintf(f, "  {\"name\":\"%s\",\"grid\":%d,\"length\":%d,\"ns_per_op\":%.2f,\"allocs_per_op\":%.3f,"
+                   "\"spread\":%.3f}%s\n",
+                r.name.c_str(), r.grid, r.length, r.ns, r.allocs, r.spread, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    return fclose(f) == 0;
+}
+
+/**
+ * @brief Read a baseline written by write_json() (one benchmark per line).
+ *
+ * Baselines without a spread field read it as 0.
+ */
+static bool read_json(const char* path, std::vector<Result>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        char name[64];
+        Result r;
+        r.spread = 0.0;
+        if (sscanf(line, " {\"name\":\"%63[^\"]\",\"grid\":%d,\"length\":%d,\"ns_per_op\":%lf,\"allocs_per_op\":%lf"
+                         ",\"spread\":%lf",
+                   name, &r.grid, &r.length, &r.ns, &r.allocs, &r.spread) >= 5) {
+            r.name = name;
+            out.push_back(r);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/**
+ * @brief Print each result against its baseline; return the number of regressions.
+ *
+ * The slowdown allowed is `threshold` or twice the summed spreads of the
+ * baseline and the new result, whichever is larger: a benchmark cannot
+ * regress by less than its own noise.
+ */
+static int compare(const std::vector<Result>& base, double threshold) {
+    int regressions = 0;
+    printf("\n%-16s %-4s %-5s %12s %12s %8s %7s\n", "benchmark", "grid", "len", "base ns", "ns", "change", "limit");
+    for (const Result& r : results) {
+        const Result* b = nullptr;
+        for (const Result& c : base) {
+            if (c.name == r.name && c.grid == r.grid && c.length == r.length) b = &c;
+        }
+        if (!b) {
+            printf("%-16s %-4d %-5d %12s %12.1f %8s  new\n", r.name.c_str(), r.grid, r.length, "-", r.ns, "");
+            continue;
+        }
+        const double change = b->ns > 0 ? r.ns / b->ns - 1.0 : 0.0;
+        const double limit = std::max(threshold, 2.0 * (b->spread + r.spread));
+        const bool slower = change > limit;
+        const bool allocs = r.allocs > b->allocs + 0.01;
+        regressions += slower || allocs;
+        printf("%-16s %-4d %-5d %12.1f %12.1f %+7.1f%% %6.1f%%%s%s\n", r.name.c_str(), r.grid, r.length,
+               b->ns, r.ns, change * 100.0, limit * 100.0, slower ? "  SLOWER" : "", allocs ? "  MORE ALLOCS" : "");
+    }
+    return regressions;
+}
+
+
+static void usage(FILE* out, const char* prog) {
+    fprintf(out,
+        "usage: %s [options]\n"
+        "  --json FILE        write the results to FILE (baseline format)\n"
+        "  --compare FILE     compare with the baseline FILE, exit 1 on regression\n"
+        "  --threshold X      smallest relative slowdown counted as a regression (default 0.15)\n"
+        "  --min-time S       seconds measured per benchmark (default 0.2)\n"
+        "  --repeats N        rounds, i.e. timed samples per benchmark, the median is kept (default 9)\n"
+        "  --filter TEXT      only run benchmarks whose name contains TEXT\n"
+        "  -h, --help         show this message\n",
+        prog);
+}
+
+int main(int argc, char** argv) {
+    const char* json = nullptr;
+    const char* baseline = nullptr;
+    double threshold = 0.15;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            usage(stdout, argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "error: unknown option or missing value: %s\n", arg.c_str());
+            usage(stderr, argv[0]);
+            return 2;
+        }
+        const char* val = argv[++i];
+        if (arg == "--json") json = val;
+        else if (arg == "--compare") baseline = val;
+        else if (arg == "--threshold") threshold = atof(val);
+        else if (arg == "--min-time") min_time = atof(val);
+        else if (arg == "--repeats") repeats = std::max(1, atoi(val));
+        else if (arg == "--filter") filter = val;
+        else {
+            fprintf(stderr, "error: unknown option: %s\n", arg.c_str());
+            usage(stderr, argv[0]);
+            return 2;
+        }
+    }
+
+    for (int round = 0; round < repeats; ++round) {
+        fprintf(stderr, "round %d/%d\r", round + 1, repeats);
+        bench_tables();
+        for (int grid : {10, 20, 40, 80}) bench_grid(grid);
+    }
+    fprintf(stderr, "\n");
+    finish();
+
+    if (json && !write_json(json)) {
+        fprintf(stderr, "error: cannot write %s\n", json);
+        return 2;
+    }
+    if (baseline) {
+        // read only now: allocating before the runs would shift the heap
+        // layout, and with it the timings, away from that of a --json run
+        std::vector<Result> base;
+        if (!read_json(baseline, base)) {
+            fprintf(stderr, "error: cannot read baseline: %s\n", baseline);
+            return 2;
+        }
+        const int regressions = compare(base, threshold);
+        printf("\n%d regression(s)\n", regressions);
+        return regressions ? 1 : 0;
+    }
+    return 0;
+}
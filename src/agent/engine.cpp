@@ -11,6 +11,8 @@
  */
 
 #include "include/engine.hpp"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <random>
 #include <unordered_map>
@@ -18,6 +20,8 @@
 #include <string>
 #include <stdbool.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 
 
@@ -84,11 +88,11 @@ static inline std::pair<int,int> vec(Dir d) {
 }
 
 
-Engine::Engine(): rng_engine(42) {
+Engine::Engine(uint64_t seed): rng_engine(seed) {
     reset_board(10);
 }
 
-Dir Engine::get_neck_dir(const std::vector<std::pair<int,int>>& snake) {
+Dir Engine::get_neck_dir(const SnakeBody& snake) {
     if (snake.size() < 2) return Dir::NONE;
     int hx = snake[0].first;
     int hy = snake[0].second;
@@ -103,56 +107,126 @@ Dir Engine::get_neck_dir(const std::vector<std::pair<int,int>>& snake) {
     return Dir::NONE;
 }
 
+int Engine::push_head(int x, int y) {
+    if (!snake.empty()) {
+        const auto [hx, hy] = snake.front();
+        board[cell(hx, hy)] = CELL_SNAKE;
+        if (snake.size() == 1) zobrist ^= zobrist_key(cell(hx, hy), ZOBRIST_LONE_HEAD);
+    }
+    snake.push_front({x, y});
+    zobrist ^= snake.size() == 1 ? zobrist_key(cell(x, y), ZOBRIST_LONE_HEAD) : link_key(1);
+    return occupy(CELL_HEAD, x, y);
+}
+
+void Engine::pop_tail() {
+    const int n = (int)snake.size();
+    const auto [tx, ty] = snake[n - 1];
+    if (n == 1) {
+        zobrist ^= zobrist_key(cell(tx, ty), ZOBRIST_LONE_HEAD);
+    } else {
+        zobrist ^= link_key(n - 1);
+        if (n == 2) zobrist ^= zobrist_key(cell(snake[0].first, snake[0].second), ZOBRIST_LONE_HEAD);
+    }
+    vacate(CELL_SNAKE, tx, ty);
+    snake.pop_back();
+}
+
+const uint64_t* Engine::zobrist_table(int cells) {
+    static std::mutex lock;
+    static std::vector<std::unique_ptr<uint64_t[]>> tables;
+    static int covered = 0;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (cells > covered) {
+        covered = std::max(cells, 2 * covered);
+        std::unique_ptr<uint64_t[]> keys(new uint64_t[(size_t)covered * 8]);
+        for (size_t i = 0; i < (size_t)covered * 8; ++i) {
+            keys[i] = Rng::mix((i + 1) * 0x9e3779b97f4a7c15ull);
+        }
+        tables.push_back(std::move(keys)); // older tables stay valid for engines using them
+    }
+    return tables.back().get();
+}
+
+uint64_t Engine::link_key(int i) const {
+    const auto [x, y] = snake[i];
+    const auto [px, py] = snake[i - 1];
+    Dir link;
+    if (px != x) link = px > x ? Dir::RIGHT : Dir::LEFT;
+    else link = py > y ? Dir::DOWN : Dir::UP;
+    return zobrist_key(cell(x, y), (int)link);
+}
+
+uint64_t Engine::compute_zobrist() const {
+    uint64_t z = 0;
+    if (snake.size() == 1) z ^= zobrist_key(cell(snake[0].first, snake[0].second), ZOBRIST_LONE_HEAD);
+    for (int i = 1; i < (int)snake.size(); ++i) z ^= link_key(i);
+    for (const auto& [x, y] : greens) z ^= zobrist_key(cell(x, y), ZOBRIST_GREEN);
+    if (red.first >= 0) z ^= zobrist_key(cell(red.first, red.second), ZOBRIST_RED);
+    return z;
+}
+
+int Engine::spawn_cell() {
+    if (free_cells.size() == 0) return -1;
+    return free_cells.at(rng_engine.below(free_cells.size()));
+}
+
 void Engine::reset_board(int grid_size) {
     grid = grid_size;
+    if (grid * grid > zobrist_cells) {
+        zobrist_keys = zobrist_table(grid * grid);
+        zobrist_cells = grid * grid;
+    }
 
-    snake.clear();
+    snake.reset(grid * grid);
     greens.clear();
     red = {-1, -1};
     game_over = false;
+    snake_bits.reset(grid);
+    green_bits.reset(grid);
+    red_bits.reset(grid);
+    free_cells.reset(grid * grid);
+    board.assign(grid * grid, CELL_EMPTY);
 
     // place snake
-    std::pair<int,int> head{0, 0};
-    do {
-        head.first = rng_engine() % grid;
-        head.second = rng_engine() % grid;
-    } while (std::find(greens.begin(), greens.end(), head) != greens.end()
-            || head == red);
+    int c = spawn_cell();
+    std::pair<int,int> head{c % grid, c / grid};
     snake.push_back(head);
+    occupy(CELL_HEAD, head.first, head.second);
     for (int i = 0; i < 2; ++i) {
         std::pair<int,int> segment{0, 0};
         std::pair<int,int> prev = snake.back();
         do {
             segment.first = prev.first;
             segment.second = prev.second;
-            int dir = rng_engine() % 4;
+            int dir = rng_engine.below(4);
             switch (dir) {
                 case 0: segment.second -= 1; break; // UP
                 case 1: segment.second += 1; break; // DOWN
                 case 2: segment.first -= 1; break; // LEFT
                 case 3: segment.first += 1; break; // RIGHT
             }
-        } while (std::find(snake.begin(), snake.end(), segment) != snake.end());
+        } while (segment.first < 0 || segment.first >= grid ||
+                segment.second < 0 || segment.second >= grid ||
+                is_snake(segment.first, segment.second));
         snake.push_back(segment);
+        occupy(CELL_SNAKE, segment.first, segment.second);
     }
 
     // place green apples
     for (int i = 0; i < 2; ++i) {
-        std::pair<int,int> green{0, 0};
-        do {
-            green.first = rng_engine() % grid;
-            green.second = rng_engine() % grid;
-        } while (std::find(greens.begin(), greens.end(), green) != greens.end() ||
-                std::find(snake.begin(), snake.end(), green) != snake.end());
-        greens.push_back(green);
+        c = spawn_cell();
+        if (c < 0) break;
+        greens.emplace_back(c % grid, c / grid);
+        occupy(CELL_GREEN, greens.back().first, greens.back().second);
     }
 
     // place red apple
-    do {
-        red.first = rng_engine() % grid;
-        red.second = rng_engine() % grid;
-    } while (std::find(greens.begin(), greens.end(), red) != greens.end() ||
-            std::find(snake.begin(), snake.end(), red) != snake.end());
+    c = spawn_cell();
+    if (c >= 0) {
+        red = {c % grid, c / grid};
+        occupy(CELL_RED, red.first, red.second);
+    }
 
     head_dir = opposite(get_neck_dir(snake));
 
@@ -161,17 +235,31 @@ void Engine::reset_board(int grid_size) {
     int nx = head.first + dx;
     int ny = head.second + dy;
 
-    while (nx < 0 || nx >= grid || ny < 0 || ny >= grid ||
-            std::find(snake.begin(), snake.end(), std::make_pair(nx, ny)) != snake.end()) {
+    while (nx < 0 || nx >= grid || ny < 0 || ny >= grid || is_snake(nx, ny)) {
         head_dir = static_cast<Dir>((static_cast<int>(head_dir) + 1) % 4);
         std::tie(dx, dy) = vec(head_dir);
         nx = head.first + dx;
         ny = head.second + dy;
     }
+
+    zobrist = compute_zobrist();
 }
 
 
 MOVE_RESULT Engine::step_forward(bool printing) {
+    MOVE_RESULT res = advance(nullptr);
+    if (printing && !game_over) print_head_vision();
+    return res;
+}
+
+
+MOVE_RESULT Engine::advance(MoveUndo* u) {
+    if (u) {
+        u->was_over = game_over;
+        u->rng = rng_engine;
+        u->red = red;
+        u->zobrist = zobrist;
+    }
     if (game_over) return MOVE_RESULT::MOVE_COLLISION;
 
     const int N = grid;
@@ -182,74 +270,94 @@ MOVE_RESULT Engine::step_forward(bool printing) {
     const int ny = hy + dy;
 
     // collision (wall or self)
-    if (nx < 0 || nx >= N || ny < 0 || ny >= N ||
-        std::find(snake.begin(), snake.end(), std::make_pair(nx, ny)) != snake.end()) {
+    if (nx < 0 || nx >= N || ny < 0 || ny >= N || is_snake(nx, ny)) {
         game_over = true;
         return MOVE_RESULT::MOVE_COLLISION;
     }
 
+    // drop the tail segment, remembering it for undo
+    auto drop_tail = [&] {
+        const auto t = snake.back();
+        if (u) {
+            u->tails[u->tail_count] = t;
+            u->tail_codes[u->tail_count++] = board[cell(t.first, t.second)];
+        }
+        pop_tail();
+    };
+    if (u) {
+        u->head = {nx, ny};
+        u->moved = true;
+    }
+
     // eat green -> grow
-    auto itg = std::find(greens.begin(), greens.end(), std::make_pair(nx, ny));
-    if (itg != greens.end()) {
+    if (is_green(nx, ny)) {
         // remove eaten one
-        greens.erase(itg);
-        // spawn new green not on snake or other green (unless grid full)
-        if ((int)snake.size() != N * N) {
-            std::pair<int,int> green{0,0};
-            do {
-                green.first = rng_engine() % grid;
-                green.second = rng_engine() % grid;
-            } while (std::find(greens.begin(), greens.end(), green) != greens.end() ||
-                    std::find(snake.begin(), snake.end(), green) != snake.end() ||
-                    green == red);
-            greens.push_back(green);
-        }
+        auto it = std::find(greens.begin(), greens.end(), std::make_pair(nx, ny));
+        if (u) u->eaten_index = (int)(it - greens.begin());
+        greens.erase(it);
+        vacate(CELL_GREEN, nx, ny);
+        zobrist ^= zobrist_key(cell(nx, ny), ZOBRIST_GREEN);
         // grow: new head + keep all segments
-        std::vector<std::pair<int,int>> newsnake;
-        newsnake.emplace_back(nx, ny);
-        newsnake.insert(newsnake.end(), snake.begin(), snake.end());
-        snake.swap(newsnake);
-        if (printing) print_head_vision();
+        const int head_slot = push_head(nx, ny);
+        // spawn new green on a free cell (unless grid full)
+        int c = spawn_cell();
+        int spawn_slot = -1;
+        if (c >= 0) {
+            greens.emplace_back(c % grid, c / grid);
+            spawn_slot = occupy(CELL_GREEN, greens.back().first, greens.back().second);
+            zobrist ^= zobrist_key(c, ZOBRIST_GREEN);
+        }
+        if (u) {
+            u->head_slot = head_slot;
+            u->spawn = c;
+            u->spawn_slot = spawn_slot;
+        }
         return MOVE_RESULT::MOVE_GREEN_APPLE;
     }
 
     // eat red -> shrink
-    if (red == std::make_pair(nx, ny)) {
+    if (is_red(nx, ny)) {
         if ((int)snake.size() == 1) {
+            if (u) u->moved = false;
             game_over = true;
             return MOVE_RESULT::MOVE_RED_APPLE;
         }
-        // respawn red not on greens/snake (unless grid full)
-        do {
-            red.first = rng_engine() % grid;
-            red.second = rng_engine() % grid;
-        } while (std::find(greens.begin(), greens.end(), red) != greens.end() ||
-                std::find(snake.begin(), snake.end(), red) != snake.end());
+        vacate(CELL_RED, nx, ny);
+        zobrist ^= zobrist_key(cell(nx, ny), ZOBRIST_RED);
         // shrink: new head + drop last 2 segments
-        std::vector<std::pair<int,int>> newsnake;
-        newsnake.emplace_back(nx, ny);
-        if (snake.size() >= 2) {
-            newsnake.insert(newsnake.end(), snake.begin(), snake.end() - 2);
+        for (int i = 0; i < 2; ++i) drop_tail();
+        const int head_slot = push_head(nx, ny);
+        // respawn red on a free cell (unless grid full)
+        int c = spawn_cell();
+        int spawn_slot = -1;
+        red = {-1, -1};
+        if (c >= 0) {
+            red = {c % grid, c / grid};
+            spawn_slot = occupy(CELL_RED, red.first, red.second);
+            zobrist ^= zobrist_key(c, ZOBRIST_RED);
+        }
+        if (u) {
+            u->head_slot = head_slot;
+            u->spawn = c;
+            u->spawn_slot = spawn_slot;
         }
-        snake.swap(newsnake);
-        if (printing) print_head_vision();
         return MOVE_RESULT::MOVE_RED_APPLE;
     }
 
     // normal move: new head + drop tail
-    {
-        std::vector<std::pair<int,int>> newsnake;
-        newsnake.emplace_back(nx, ny);
-        newsnake.insert(newsnake.end(), snake.begin(), snake.end() - 1);
-        snake.swap(newsnake);
-        if (printing) print_head_vision();
-        return MOVE_RESULT::MOVE_OK;
-    }
+    drop_tail();
+    const int head_slot = push_head(nx, ny);
+    if (u) u->head_slot = head_slot;
+    return MOVE_RESULT::MOVE_OK;
 }
 
 
 void Engine::change_dir(const std::string& new_dir_s) {
-    Dir new_dir = from_str(new_dir_s);
+    turn(from_str(new_dir_s));
+}
+
+
+void Engine::turn(Dir new_dir) {
     Dir neck = get_neck_dir(snake);
     if (new_dir != neck && new_dir != Dir::NONE) {
         head_dir = new_dir;
@@ -257,15 +365,109 @@ void Engine::change_dir(const std::string& new_dir_s) {
 }
 
 
+Dir Engine::action_dir(int action) {
+    switch (action) {
+        case 0: return Dir::UP;
+        case 1: return Dir::RIGHT;
+        case 2: return Dir::DOWN;
+        case 3: return Dir::LEFT;
+        default: return Dir::NONE;
+    }
+}
+
+
+StepInfo Engine::step(int action) {
+    turn(action_dir(action));
+    MOVE_RESULT res = step_forward(false);
+    return {
+        res,
+        res == MOVE_RESULT::MOVE_GREEN_APPLE,
+        res == MOVE_RESULT::MOVE_RED_APPLE,
+        game_over,
+        snake.size()
+    };
+}
+
+
+MoveUndo Engine::make_move(int action) {
+    MoveUndo u;
+    u.dir = head_dir;
+    turn(action_dir(action));
+    u.result = advance(&u);
+    return u;
+}
+
+
+void Engine::unmake_move(const MoveUndo& u) {
+    head_dir = u.dir;
+    game_over = u.was_over;
+    rng_engine = u.rng;
+    zobrist = u.zobrist;
+    if (!u.moved) return;
+
+    const auto [nx, ny] = u.head;
+    const int n = cell(nx, ny);
+
+    // respawned apple
+    if (u.spawn >= 0) {
+        const int sx = u.spawn % grid, sy = u.spawn / grid;
+        if (u.result == MOVE_RESULT::MOVE_GREEN_APPLE) {
+            greens.pop_back();
+            green_bits.clear(sx, sy);
+        } else {
+            red_bits.clear(sx, sy);
+        }
+        board[u.spawn] = CELL_EMPTY;
+        free_cells.unremove(u.spawn, u.spawn_slot);
+    }
+    red = u.red;
+
+    // new head
+    snake_bits.clear(nx, ny);
+    board[n] = CELL_EMPTY;
+    free_cells.unremove(n, u.head_slot);
+    snake.pop_front();
+    if (!snake.empty()) board[cell(snake.front().first, snake.front().second)] = CELL_HEAD;
+
+    // dropped tail segments, last dropped first
+    for (int i = u.tail_count - 1; i >= 0; --i) {
+        const auto t = u.tails[i];
+        const int c = cell(t.first, t.second);
+        snake.push_back(t);
+        snake_bits.set(t.first, t.second);
+        board[c] = u.tail_codes[i];
+        free_cells.uninsert(c);
+    }
+
+    // eaten apple
+    if (u.result == MOVE_RESULT::MOVE_GREEN_APPLE) {
+        free_cells.uninsert(n);
+        green_bits.set(nx, ny);
+        board[n] = CELL_GREEN;
+        greens.insert(greens.begin() + u.eaten_index, u.head);
+    } else if (u.result == MOVE_RESULT::MOVE_RED_APPLE) {
+        free_cells.uninsert(n);
+        red_bits.set(nx, ny);
+        board[n] = CELL_RED;
+    }
+}
+
+
+#ifndef L2S_HEADLESS
 py::dict Engine::get_board() const {
     py::dict b;
-    b["snake"] = snake; // list of (x,y) tuples
+    py::list body;
+    for (int i = 0; i < snake.size(); ++i) {
+        body.append(py::make_tuple(snake[i].first, snake[i].second));
+    }
+    b["snake"] = body; // list of (x,y) tuples
     b["greens"] = greens; // list of (x,y)
     b["red"] = py::make_tuple(red.first, red.second); // (x,y) or None in your logic
     b["head_dir"] = to_str(head_dir);
     b["game_over"] = game_over;
     return b;
 }
+#endif
 
 
 std::vector<std::string> Engine::get_head_vision() {
@@ -283,12 +485,11 @@ std::vector<std::string> Engine::get_head_vision() {
                 cell_contents += "W";
                 break;
             }
-            std::pair<int,int> pos{x, y};
-            if (std::find(snake.begin(), snake.end(), pos) != snake.end()) {
+            if (is_snake(x, y)) {
                 cell_contents += "S";
-            } else if (std::find(greens.begin(), greens.end(), pos) != greens.end()) {
+            } else if (is_green(x, y)) {
                 cell_contents += "G";
-            } else if (red == pos) {
+            } else if (is_red(x, y)) {
                 cell_contents += "R";
             } else {
                 cell_contents += "0";
@@ -300,6 +501,54 @@ std::vector<std::string> Engine::get_head_vision() {
 }
 
 
+int Engine::first_hit(const Bitboard& bits, Dir d) const {
+    const auto [hx, hy] = snake[0];
+    int p;
+    switch (d) {
+        case Dir::UP:
+            p = bits.prev(bits.col(hx), hy);
+            return p < 0 ? 0 : hy - p;
+        case Dir::DOWN:
+            p = bits.next(bits.col(hx), hy);
+            return p < 0 ? 0 : p - hy;
+        case Dir::LEFT:
+            p = bits.prev(bits.row(hy), hx);
+            return p < 0 ? 0 : hx - p;
+        case Dir::RIGHT:
+            p = bits.next(bits.row(hy), hx);
+            return p < 0 ? 0 : p - hx;
+        default:
+            return 0;
+    }
+}
+
+
+int Engine::wall_distance(Dir d) const {
+    const auto [hx, hy] = snake[0];
+    switch (d) {
+        case Dir::UP: return hy + 1;
+        case Dir::DOWN: return grid - hy;
+        case Dir::LEFT: return hx + 1;
+        case Dir::RIGHT: return grid - hx;
+        default: return 0;
+    }
+}
+
+
+Sensors Engine::sense() const {
+    Sensors s;
+    int i = 0;
+    for (Dir d : {Dir::UP, Dir::RIGHT, Dir::DOWN, Dir::LEFT}) {
+        s.wall[i] = wall_distance(d);
+        s.body[i] = first_hit(snake_bits, d);
+        s.green[i] = first_hit(green_bits, d);
+        s.red[i] = first_hit(red_bits, d);
+        ++i;
+    }
+    return s;
+}
+
+
 void Engine::print_head_vision() {
     auto vision = get_head_vision();
     const size_t left_len = vision[3].length();
@@ -317,4 +566,86 @@ void Engine::print_head_vision() {
         std::cout << line << std::endl;
     }
     std::cout << std::endl;
-}
\ No newline at end of file
+}
+
+
+void Engine::snapshot(EngineSnapshot& out) const {
+    out.grid = grid;
+    out.head_dir = head_dir;
+    out.game_over = game_over;
+    out.green_count = (int)greens.size();
+    for (int i = 0; i < out.green_count; ++i) out.greens[i] = greens[i];
+    out.red = red;
+    out.rng = rng_engine;
+    out.zobrist = zobrist;
+
+    out.body.resize(snake.size());
+    std::copy_n(snake.data(), snake.size(), out.body.data());
+
+    const size_t words = snake_bits.rows.size();
+    out.bits.resize(6 * words);
+    uint64_t* w = out.bits.data();
+    for (const Bitboard* b : {&snake_bits, &green_bits, &red_bits}) {
+        std::memcpy(w, b->rows.data(), words * sizeof(uint64_t));
+        std::memcpy(w + words, b->cols.data(), words * sizeof(uint64_t));
+        w += 2 * words;
+    }
+
+    out.free_cells.resize(free_cells.count);
+    std::copy_n(free_cells.cells.data(), free_cells.count, out.free_cells.data()); // may be empty
+    out.free_slot = free_cells.slot;
+    out.board = board;
+}
+
+
+EngineSnapshot Engine::snapshot() const {
+    EngineSnapshot snap;
+    snapshot(snap);
+    return snap;
+}
+
+
+void Engine::restore(const EngineSnapshot& snap) {
+    const int area = snap.grid * snap.grid;
+    if (grid != snap.grid || snake.cap != area) {
+        grid = snap.grid;
+        snake.reset(area);
+        snake_bits.reset(grid);
+        green_bits.reset(grid);
+        red_bits.reset(grid);
+        free_cells.cells.resize(area);
+        free_cells.slot.resize(area);
+        board.resize(area);
+        if (area > zobrist_cells) {
+            zobrist_keys = zobrist_table(area);
+            zobrist_cells = area;
+        }
+    }
+
+    head_dir = snap.head_dir;
+    game_over = snap.game_over;
+    greens.assign(snap.greens, snap.greens + snap.green_count);
+    red = snap.red;
+    rng_engine = snap.rng;
+    zobrist = snap.zobrist;
+
+    // body at slots [0, len) and their mirrors
+    const size_t len = snap.body.size();
+    snake.head = 0;
+    snake.len = (int)len;
+    std::copy_n(snap.body.data(), len, &snake.cells[0]);
+    std::copy_n(snap.body.data(), len, &snake.cells[snake.cap]);
+
+    const size_t words = snake_bits.rows.size();
+    const uint64_t* w = snap.bits.data();
+    for (Bitboard* b : {&snake_bits, &green_bits, &red_bits}) {
+        std::memcpy(b->rows.data(), w, words * sizeof(uint64_t));
+        std::memcpy(b->cols.data(), w + words, words * sizeof(uint64_t));
+        w += 2 * words;
+    }
+
+    free_cells.count = (int)snap.free_cells.size();
+    std::copy_n(snap.free_cells.data(), free_cells.count, free_cells.cells.data());
+    std::memcpy(free_cells.slot.data(), snap.free_slot.data(), area * sizeof(int));
+    std::memcpy(board.data(), snap.board.data(), area);
+}
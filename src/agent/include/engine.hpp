@@ -2,6 +2,9 @@
 #define ENGINE_HPP
 
 #include "learn2slither.hpp"
+#include "rng.hpp"
+#include <cstdint>
+#include <vector>
 
 /**
  * @enum Dir
@@ -11,6 +14,307 @@
  */
 enum class Dir { UP, DOWN, LEFT, RIGHT, NONE };
 
+/**
+ * @enum CellCode
+ * @brief Content of one cell in Engine::board (the exported board array).
+ */
+enum CellCode : uint8_t { CELL_EMPTY, CELL_SNAKE, CELL_HEAD, CELL_GREEN, CELL_RED };
+
+/**
+ * @brief First-hit distances seen from the snake head.
+ *
+ * Each array is indexed UP, RIGHT, DOWN, LEFT (same order as get_head_vision)
+ * and holds the distance in cells (1 = adjacent) to the first cell of that
+ * kind along the ray, or 0 if there is none before the wall. The wall entry
+ * is never 0.
+ */
+struct Sensors {
+    uint8_t wall[4];  ///< Distance to the wall.
+    uint8_t body[4];  ///< Distance to the first snake segment.
+    uint8_t green[4]; ///< Distance to the first green apple.
+    uint8_t red[4];   ///< Distance to the red apple.
+};
+
+/**
+ * @brief Outcome of one Engine::step() call.
+ */
+struct StepInfo {
+    MOVE_RESULT result; ///< What the move did.
+    bool ate_green;     ///< A green apple was eaten (snake grew).
+    bool ate_red;       ///< The red apple was eaten (snake shrank).
+    bool done;          ///< The game is over after this move.
+    int length;         ///< Snake length after the move.
+};
+
+/**
+ * @brief Occupancy bitset over the grid, stored both row-major and column-major.
+ *
+ * Each row (and each column) is `stride` 64-bit words, so besides O(1) cell
+ * tests the first occupied cell along a row or column from a given position is
+ * found with a count-trailing/leading-zeros on one word in the common case
+ * (grid <= 64), instead of walking the cells.
+ */
+struct Bitboard {
+    int stride = 1;             ///< 64-bit words per row / column.
+    std::vector<uint64_t> rows; ///< Bit x of row y lives in rows[y * stride + x / 64].
+    std::vector<uint64_t> cols; ///< Bit y of column x lives in cols[x * stride + y / 64].
+
+    /**
+     * @brief Resize for a grid × grid board and clear every cell.
+     *
+     * @param grid Grid size.
+     */
+    void reset(int grid) {
+        stride = (grid + 63) / 64;
+        rows.assign((size_t)grid * stride, 0);
+        cols.assign((size_t)grid * stride, 0);
+    }
+
+    /// Is cell (x, y) set?
+    bool test(int x, int y) const { return (rows[y * stride + (x >> 6)] >> (x & 63)) & 1ULL; }
+
+    /// Mark cell (x, y).
+    void set(int x, int y) {
+        rows[y * stride + (x >> 6)] |= 1ULL << (x & 63);
+        cols[x * stride + (y >> 6)] |= 1ULL << (y & 63);
+    }
+
+    /// Unmark cell (x, y).
+    void clear(int x, int y) {
+        rows[y * stride + (x >> 6)] &= ~(1ULL << (x & 63));
+        cols[x * stride + (y >> 6)] &= ~(1ULL << (y & 63));
+    }
+
+    /**
+     * @brief Smallest set index greater than `pos` in one line, or -1.
+     *
+     * @param line First word of the row / column.
+     * @param pos Starting index (excluded).
+     */
+    int next(const uint64_t* line, int pos) const {
+        int p = pos + 1;
+        int w = p >> 6;
+        if (w >= stride) return -1;
+        uint64_t m = line[w] & (~0ULL << (p & 63));
+        while (!m) {
+            if (++w >= stride) return -1;
+            m = line[w];
+        }
+        return (w << 6) + __builtin_ctzll(m);
+    }
+
+    /**
+     * @brief Largest set index smaller than `pos` in one line, or -1.
+     *
+     * @param line First word of the row / column.
+     * @param pos Starting index (excluded).
+     */
+    int prev(const uint64_t* line, int pos) const {
+        int p = pos - 1;
+        if (p < 0) return -1;
+        int w = p >> 6;
+        uint64_t m = line[w] & (~0ULL >> (63 - (p & 63)));
+        while (!m) {
+            if (--w < 0) return -1;
+            m = line[w];
+        }
+        return (w << 6) + 63 - __builtin_clzll(m);
+    }
+
+    const uint64_t* row(int y) const { return &rows[y * stride]; } ///< Words of row y.
+    const uint64_t* col(int x) const { return &cols[x * stride]; } ///< Words of column x.
+};
+
+/**
+ * @brief Set of free cells with O(1) insert, remove and uniform random pick.
+ *
+ * `cells[0..count)` lists the free cells in no particular order and `slot` maps
+ * each cell back to its position in that array (-1 when occupied), so removal
+ * is a swap with the last free entry.
+ */
+struct FreeCells {
+    std::vector<int> cells; ///< Free cell ids, only the first `count` are valid.
+    std::vector<int> slot;  ///< Cell id -> index in `cells`, or -1 if occupied.
+    int count = 0;          ///< Number of free cells.
+
+    /**
+     * @brief Mark every one of the `n` cells as free.
+     *
+     * @param n Number of cells on the board (grid * grid).
+     */
+    void reset(int n) {
+        cells.resize(n);
+        slot.resize(n);
+        for (int c = 0; c < n; ++c) {
+            cells[c] = c;
+            slot[c] = c;
+        }
+        count = n;
+    }
+
+    int size() const { return count; }                    ///< Number of free cells.
+    int at(int i) const { return cells[i]; }               ///< i-th free cell, i < size().
+    bool contains(int c) const { return slot[c] >= 0; }    ///< Is cell `c` free?
+
+    /// Mark cell `c` as occupied (must currently be free); returns the slot it had.
+    int remove(int c) {
+        int s = slot[c];
+        int last = cells[--count];
+        cells[s] = last;
+        slot[last] = s;
+        cells[count] = c;
+        slot[c] = -1;
+        return s;
+    }
+
+    /// Mark cell `c` as free (must currently be occupied).
+    void insert(int c) {
+        cells[count] = c;
+        slot[c] = count++;
+    }
+
+    /// Undo the last remove(c), which returned `s`: the order is restored exactly.
+    void unremove(int c, int s) {
+        if (s < count) { // c was swapped out of the middle: move the tail cell back
+            const int last = cells[s];
+            cells[count] = last;
+            slot[last] = count;
+        }
+        cells[s] = c;
+        slot[c] = s;
+        ++count;
+    }
+
+    /// Undo the last insert(c).
+    void uninsert(int c) {
+        --count;
+        slot[c] = -1;
+    }
+};
+
+/**
+ * @brief Snake body stored as a fixed-capacity circular buffer, head first.
+ *
+ * Capacity is grid * grid (the snake can never be longer), so moving is a
+ * push_front of the new head plus pop_back of the tail, both O(1) and without
+ * any allocation once reset() has sized the buffer.
+ *
+ * The ring is mirrored: slot i and slot i + capacity always hold the same
+ * segment, so the body is one contiguous run `data()[0..size())` in head-first
+ * order whatever the head position. This is what lets the body be exported to
+ * NumPy without copying.
+ */
+struct SnakeBody {
+    std::vector<std::pair<int,int>> cells; ///< Mirrored ring storage (2 * capacity).
+    int cap = 0;                           ///< Capacity (grid * grid).
+    int head = 0;                          ///< Slot holding the head, in [0, cap).
+    int len = 0;                           ///< Number of segments.
+
+    /**
+     * @brief Empty the body and make room for `capacity` segments.
+     *
+     * Only reallocates when the capacity changes (i.e. on a grid size change).
+     *
+     * @param capacity Maximum number of segments (grid * grid).
+     */
+    void reset(int capacity) {
+        if (cap != capacity) cells.assign(2 * (size_t)capacity, {0, 0});
+        cap = capacity;
+        head = 0;
+        len = 0;
+    }
+
+    int size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    /**
+     * @brief Segment `i` counted from the head (0 = head, size()-1 = tail).
+     */
+    const std::pair<int,int>& operator[](int i) const { return cells[head + i]; }
+
+    const std::pair<int,int>& front() const { return cells[head]; }       ///< Head segment.
+    const std::pair<int,int>& back() const { return cells[head + len - 1]; } ///< Tail segment.
+
+    /// Contiguous head-first view of the body, valid for size() segments.
+    const std::pair<int,int>* data() const { return &cells[head]; }
+
+    /// Add a new head segment.
+    void push_front(std::pair<int,int> p) {
+        head = head == 0 ? cap - 1 : head - 1;
+        cells[head] = p;
+        cells[head + cap] = p;
+        ++len;
+    }
+
+    /// Append a segment after the current tail (used when building the body).
+    void push_back(std::pair<int,int> p) {
+        int slot = head + len;
+        if (slot >= cap) slot -= cap;
+        cells[slot] = p;
+        cells[slot + cap] = p;
+        ++len;
+    }
+
+    /// Drop the tail segment.
+    void pop_back() { --len; }
+
+    /// Drop the head segment (undoes push_front()).
+    void pop_front() {
+        head = head + 1 == cap ? 0 : head + 1;
+        --len;
+    }
+};
+
+/**
+ * @brief Copy of an Engine's state, restorable with Engine::restore().
+ *
+ * Holds only what the game needs to continue exactly as the original would
+ * (including the free-cell order and RNG state, which decide the next
+ * spawns): scalars plus flat arrays whose size depends on the grid and the
+ * snake length. Reusing one snapshot for the same grid size never
+ * allocates, so taking or restoring one is a handful of memcpy calls.
+ */
+struct EngineSnapshot {
+    int grid = 0;                            ///< Grid size.
+    Dir head_dir = Dir::UP;                  ///< Head direction.
+    bool game_over = false;                  ///< Game over flag.
+    int green_count = 0;                     ///< Valid entries in `greens`.
+    std::pair<int,int> greens[2];            ///< Green apples.
+    std::pair<int,int> red{-1, -1};          ///< Red apple (or (-1,-1) if absent).
+    Rng rng;                                 ///< Generator state.
+    uint64_t zobrist = 0;                    ///< Engine::zobrist.
+    std::vector<std::pair<int,int>> body;    ///< Snake segments, head first.
+    std::vector<uint64_t> bits;              ///< Snake, green and red bitboard words (rows then cols each).
+    std::vector<int> free_cells;             ///< FreeCells::cells[0..count).
+    std::vector<int> free_slot;              ///< FreeCells::slot.
+    std::vector<uint8_t> board;              ///< CellCode of every cell.
+};
+
+/**
+ * @brief What Engine::make_move() changed, so unmake_move() can revert it.
+ *
+ * Records the cells and free-cell slots the move touched, plus the previous
+ * direction, flags and RNG state; reverting is O(1) and leaves the engine
+ * bit-for-bit as it was (free-cell order included).
+ */
+struct MoveUndo {
+    MOVE_RESULT result = MOVE_OK;     ///< Result of the move.
+    bool moved = false;               ///< The snake moved (false on collision / game already over).
+    bool was_over = false;            ///< game_over before the move.
+    Dir dir = Dir::UP;                ///< head_dir before the move.
+    Rng rng;                          ///< Generator state before the move.
+    uint64_t zobrist = 0;             ///< Engine::zobrist before the move.
+    std::pair<int,int> head{0, 0};    ///< Cell the head moved into.
+    int head_slot = -1;               ///< Free-cell slot of that cell before the move.
+    int tail_count = 0;               ///< Tail segments dropped (0, 1 or 2).
+    std::pair<int,int> tails[2];      ///< Dropped tail segments, in drop order.
+    uint8_t tail_codes[2] = {0, 0};   ///< CellCode of those cells before the move.
+    int eaten_index = -1;             ///< Index of the eaten green in `greens`.
+    std::pair<int,int> red{-1, -1};   ///< Red apple before the move.
+    int spawn = -1;                   ///< Cell of the respawned apple, or -1.
+    int spawn_slot = -1;              ///< Free-cell slot of that cell before the spawn.
+};
+
 /**
  * @brief Engine implementing the Learn2Slither board logic.
  *
@@ -21,20 +325,35 @@ struct Engine {
     int grid = 10; ///< Current grid size (width==height==grid).
 
     // board state
-    std::vector<std::pair<int,int>> snake;  ///< Snake body, head first.
+    SnakeBody snake;                        ///< Snake body, head first.
     std::vector<std::pair<int,int>> greens; ///< Two green apples.
     std::pair<int,int> red{-1, -1};         ///< Red apple (or (-1,-1) if absent).
     Dir head_dir = Dir::UP;                 ///< Current head direction.
     bool game_over = false;                 ///< Game over flag.
 
-    std::mt19937 rng_engine;  ///< Random number generator.
+    // occupancy, kept in sync with snake / greens / red on every change
+    Bitboard snake_bits; ///< Cells covered by the snake body.
+    Bitboard green_bits; ///< Cells holding a green apple.
+    Bitboard red_bits;   ///< Cell holding the red apple.
+    FreeCells free_cells; ///< Cells holding neither snake nor apple.
+    std::vector<uint8_t> board; ///< CellCode of every cell, row-major (grid * grid).
+
+    Rng rng_engine;  ///< Random number generator (spawns and snake placement).
+
+    /// Zobrist hash of the snake and apples, updated on every move; see hash().
+    uint64_t zobrist = 0;
+    const uint64_t* zobrist_keys = nullptr; ///< Shared key table, see zobrist_table().
+    int zobrist_cells = 0;                  ///< Cells covered by `zobrist_keys`.
+
+    /// Zobrist key kinds after the link directions (Dir::UP..Dir::RIGHT).
+    enum ZobristKind { ZOBRIST_LONE_HEAD = 4, ZOBRIST_GREEN, ZOBRIST_RED, ZOBRIST_DIR };
 
     /**
      * @brief Construct the engine and initialize a 10×10 board.
      *
-     * Seeds RNG from high-resolution clock.
+     * @param seed Seed of the engine's random generator.
      */
-    Engine();
+    explicit Engine(uint64_t seed = 42);
 
     /**
      * @brief Get direction from head to neck (used to forbid instant reverse).
@@ -42,8 +361,103 @@ struct Engine {
      * @param snake Body with head at index 0.
      * @return Dir toward the neck, or NONE if snake length < 2.
      */
-    static Dir get_neck_dir(const std::vector<std::pair<int,int>>& snake);
+    static Dir get_neck_dir(const SnakeBody& snake);
+
+    /**
+     * @brief Linear cell index of (x, y), used to address the bitboards.
+     */
+    int cell(int x, int y) const { return y * grid + x; }
+
+    /**
+     * @brief O(1) occupancy queries; (x, y) must be inside the grid.
+     */
+    bool is_snake(int x, int y) const { return snake_bits.test(x, y); }
+    bool is_green(int x, int y) const { return green_bits.test(x, y); }
+    bool is_red(int x, int y) const { return red_bits.test(x, y); }
+
+    /**
+     * @brief Bitboard holding cells of the given kind (HEAD shares snake_bits).
+     */
+    Bitboard& bits_of(CellCode code) {
+        switch (code) {
+            case CELL_GREEN: return green_bits;
+            case CELL_RED: return red_bits;
+            default: return snake_bits;
+        }
+    }
+
+    /**
+     * @brief Put / remove a `code` item on cell (x, y), keeping the bitboards,
+     *        free_cells and board in sync.
+     */
+    int occupy(CellCode code, int x, int y) {
+        const int c = cell(x, y);
+        bits_of(code).set(x, y);
+        const int s = free_cells.remove(c);
+        board[c] = code;
+        return s; // free-cell slot the cell had, for MoveUndo
+    }
+    void vacate(CellCode code, int x, int y) {
+        const int c = cell(x, y);
+        bits_of(code).clear(x, y);
+        free_cells.insert(c);
+        board[c] = CELL_EMPTY;
+    }
+
+    /**
+     * @brief Add (x, y) as the new head, turning the old head into body.
+     *
+     * @return Free-cell slot (x, y) had.
+     */
+    int push_head(int x, int y);
+
+    /**
+     * @brief Drop the tail segment, turning the one before it into the tail.
+     */
+    void pop_tail();
+
+    /**
+     * @brief Process-wide table of Zobrist keys covering at least `cells` cells.
+     *
+     * Key (c, kind) is at [c * 8 + kind] and is a fixed hash of the pair, so
+     * every table (and every run) agrees on it. Tables only grow and are
+     * kept until exit, so engines can hold on to the pointer.
+     */
+    static const uint64_t* zobrist_table(int cells);
 
+    /**
+     * @brief Zobrist key of `kind` on cell `c` (for ZOBRIST_DIR, `c` is the Dir).
+     */
+    uint64_t zobrist_key(int c, int kind) const { return zobrist_keys[c * 8 + kind]; }
+
+    /**
+     * @brief Key of body segment `i` (i >= 1): its cell and the direction to
+     *        segment i - 1.
+     *
+     * Each segment linking toward the head makes the hash depend on the
+     * body's order, not only on the cells it covers, and a move only changes
+     * the key of the old head and of the tail. The links also pin down the
+     * head, except for a 1-cell snake, which gets a ZOBRIST_LONE_HEAD key.
+     */
+    uint64_t link_key(int i) const;
+
+    /**
+     * @brief Zobrist hash of the board from scratch, O(length + apples).
+     */
+    uint64_t compute_zobrist() const;
+
+    /**
+     * @brief 64-bit hash of the full game state: snake body, apples and head
+     *        direction. Equal states hash equal; O(1).
+     */
+    uint64_t hash() const { return zobrist ^ zobrist_key((int)head_dir, ZOBRIST_DIR); }
+
+    /**
+     * @brief Pick a uniformly random free cell in O(1).
+     *
+     * @return Cell index, or -1 when the board is full.
+     */
+    int spawn_cell();
 
     /**
      * @brief Reset the board to a fresh random state.
@@ -66,6 +480,11 @@ struct Engine {
      */
     MOVE_RESULT step_forward(bool printing = true);
 
+    /**
+     * @brief step_forward() body, recording its changes in `undo` when not null.
+     */
+    MOVE_RESULT advance(MoveUndo* undo);
+
     /**
      * @brief Change the snake's head direction safely.
      *
@@ -75,6 +494,45 @@ struct Engine {
      */
     void change_dir(const std::string& new_dir_s);
 
+    /**
+     * @brief Same as change_dir() without the string round-trip.
+     *
+     * @param new_dir New direction; NONE and the neck direction are ignored.
+     */
+    void turn(Dir new_dir);
+
+    /**
+     * @brief Direction for an action index as used by the trainer.
+     *
+     * @param action 0 = UP, 1 = RIGHT, 2 = DOWN, 3 = LEFT.
+     * @return Matching direction, or NONE for any other value.
+     */
+    static Dir action_dir(int action);
+
+    /**
+     * @brief Turn towards `action` then move forward one cell, without printing.
+     *
+     * @param action 0 = UP, 1 = RIGHT, 2 = DOWN, 3 = LEFT.
+     * @return Result of the move and the resulting game state.
+     */
+    StepInfo step(int action);
+
+    /**
+     * @brief Like step(), but return a record that unmake_move() can revert.
+     *
+     * @param action 0 = UP, 1 = RIGHT, 2 = DOWN, 3 = LEFT.
+     */
+    MoveUndo make_move(int action);
+
+    /**
+     * @brief Revert the move recorded in `undo` in O(1).
+     *
+     * Moves must be unmade in the reverse order they were made (LIFO), with
+     * no other change to the engine in between.
+     */
+    void unmake_move(const MoveUndo& undo);
+
+#ifndef L2S_HEADLESS
     /**
      * @brief Get the current board state as a Python dictionary.
      *
@@ -88,6 +546,7 @@ struct Engine {
      * @return Python dictionary representing the board state.
      */
     py::dict get_board() const;
+#endif
 
     /**
      * @brief Get the contents of the line of cells in the four cardinal directions from the head.
@@ -104,6 +563,31 @@ struct Engine {
      */
     std::vector<std::string> get_head_vision();
 
+    /**
+     * @brief First-hit distances to wall, body and apples in the four directions.
+     *
+     * Allocation-free counterpart of get_head_vision().
+     *
+     * @return Sensors for the current head position.
+     */
+    Sensors sense() const;
+
+    /**
+     * @brief Distance from the head to the first cell of `bits` in direction `d`.
+     *
+     * Answered from the row / column masks of the bitboard in a few instructions.
+     *
+     * @param bits One of snake_bits, green_bits or red_bits.
+     * @param d Direction to look in.
+     * @return Distance in cells (1 = adjacent), or 0 if nothing before the wall.
+     */
+    int first_hit(const Bitboard& bits, Dir d) const;
+
+    /**
+     * @brief Distance from the head to the wall in direction `d` (always >= 1).
+     */
+    int wall_distance(Dir d) const;
+
     /**
      * @brief Print the head vision in a formatted way.
      *
@@ -111,6 +595,24 @@ struct Engine {
      */
     void print_head_vision();
 
+    /**
+     * @brief Copy the current state into `out`, reusing its buffers.
+     */
+    void snapshot(EngineSnapshot& out) const;
+
+    /**
+     * @brief Copy of the current state.
+     */
+    EngineSnapshot snapshot() const;
+
+    /**
+     * @brief Put the engine back in the state captured by `snap`.
+     *
+     * The engine may currently have another grid size; its buffers are then
+     * resized first.
+     */
+    void restore(const EngineSnapshot& snap);
+
 };
 
 #endif
\ No newline at end of file
@@ -1,12 +1,16 @@
 #ifndef LEARN2SLITHER_HPP
 #define LEARN2SLITHER_HPP
 
+// Define L2S_HEADLESS to build the engine and trainer without Python
+// (see the Makefile); the pybind11-only parts are left out.
+#ifndef L2S_HEADLESS
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/functional.h>
-#include <random>
 
 namespace py = pybind11;
+#endif
+#include <random>
 
 enum MOVE_RESULT {
     MOVE_OK,
@@ -15,4 +19,41 @@ enum MOVE_RESULT {
     MOVE_GREEN_APPLE
 };
 
+/**
+ * @brief Reward given to the agent for each kind of move.
+ *
+ * `closer` replaces `move` on a normal step that brings the head closer to a
+ * green apple.
+ */
+struct Rewards {
+    double move = -0.1;
+    double closer = +5.0;
+    double collision = -100.0;
+    double red_apple = -30.0;
+    double green_apple = +50.0;
+
+    /**
+     * @brief Reward of a move.
+     *
+     * @param res Result of the move.
+     * @param green_before State::nearest_green_dist before the move.
+     * @param green_after State::nearest_green_dist after the move.
+     */
+    double of(MOVE_RESULT res, int green_before, int green_after) const {
+        switch (res) {
+            case MOVE_OK:
+                // getting closer to green apple, else small penalty for normal move
+                return (green_after < green_before && green_after > 0) ? closer : move;
+            case MOVE_COLLISION:
+                return collision;
+            case MOVE_RED_APPLE:
+                return red_apple;
+            case MOVE_GREEN_APPLE:
+                return green_apple;
+            default:
+                return -1.0;
+        }
+    }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef MODEL_HPP
+#define MODEL_HPP
+
+#include "qtable.hpp"
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Header of a saved model file.
+ *
+ * A model file is this header followed by three packed arrays of `count`
+ * entries each: the visited state indices in increasing order (uint32_t),
+ * their Q-values (QValues) and their visit counts (uint32_t). `checksum` is
+ * the FNV-1a hash of the header (with `checksum` zeroed) followed by those
+ * arrays. Fields are stored in native byte order.
+ */
+struct ModelHeader {
+    char magic[4];          ///< "L2SQ".
+    uint32_t version;       ///< File format version, MODEL_VERSION.
+    uint32_t state_version; ///< State::VERSION of the encoding the keys use.
+    int32_t grid;           ///< Board size the model was trained on.
+    int32_t episodes;       ///< Episodes of the training run.
+    int32_t reserved;       ///< Zero, keeps the doubles aligned.
+    double alpha;           ///< Learning rate.
+    double gamma;           ///< Discount factor.
+    double eps_start;       ///< Exploration rate of the first episode.
+    double eps_end;         ///< Floor of the exploration rate.
+    uint64_t count;         ///< Number of entries.
+    uint64_t checksum;      ///< FNV-1a hash of the header and the entry arrays.
+};
+
+constexpr uint32_t MODEL_VERSION = 2; ///< Current file format version (1 did not hash the header).
+constexpr char MODEL_MAGIC[4] = {'L', '2', 'S', 'Q'}; ///< First bytes of a model file.
+
+/**
+ * @brief Training settings stored alongside a model.
+ */
+struct ModelInfo {
+    int grid = 10;
+    int episodes = 0;
+    double alpha = 0.0;
+    double gamma = 0.0;
+    double eps_start = 0.0;
+    double eps_end = 0.0;
+};
+
+/**
+ * @brief Write the visited entries of `Q` and `info` to `path`.
+ *
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_model(const std::string& path, const QTable& Q, const ModelInfo& info);
+
+/**
+ * @brief Replace the content of `Q` with the model saved at `path`.
+ *
+ * The file is read with a single bulk read, checked, then its entries are
+ * copied into the dense table.
+ *
+ * @return Training settings stored in the file.
+ * @throws std::runtime_error if the file cannot be read, is not a model,
+ *         has another version or state encoding, or is corrupted.
+ */
+ModelInfo load_model(const std::string& path, QTable& Q);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef POLICY_HPP
+#define POLICY_HPP
+
+#include "model.hpp"
+#include "state.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Read-only greedy policy served straight from a memory-mapped model file.
+ *
+ * Opening a model only maps the file and checks its header, so it takes the
+ * same time whatever the model size, and processes using the same model
+ * share its pages. Lookups binary-search the sorted key array of the file
+ * (see ModelHeader); states missing from the model have all-zero Q-values.
+ * The checksum is not verified, as that would read the whole file.
+ */
+struct Policy {
+    /**
+     * @brief Map the model file at `path`.
+     *
+     * @throws std::runtime_error if the file cannot be mapped, is not a model,
+     *         or has another version or state encoding.
+     */
+    explicit Policy(const std::string& path);
+    ~Policy();
+
+    Policy(const Policy&) = delete;
+    Policy& operator=(const Policy&) = delete;
+
+    size_t size() const { return count; }           ///< Number of states in the model.
+    const ModelHeader& header() const { return *hdr; } ///< Header of the mapped file.
+
+    /**
+     * @brief Q-values of state index `idx` (zeros if not in the model).
+     */
+    QValues lookup(uint32_t idx) const;
+
+    /**
+     * @brief Best action (0 UP, 1 RIGHT, 2 DOWN, 3 LEFT) in state `s`.
+     */
+    int act(const State& s, TieBreak ties = TIE_RANDOM) const { return argmax4(lookup(s.index()), ties); }
+
+private:
+    void* map = nullptr;              ///< Start of the mapping.
+    size_t map_size = 0;              ///< Length of the mapping.
+    const ModelHeader* hdr = nullptr; ///< File header.
+    const uint32_t* keys = nullptr;   ///< Sorted state indices.
+    const QValues* values = nullptr;  ///< Q-values, parallel to keys.
+    size_t count = 0;                 ///< Number of entries.
+};
+
+#endif
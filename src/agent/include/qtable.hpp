@@ -0,0 +1,122 @@
+#ifndef QTABLE_HPP
+#define QTABLE_HPP
+
+#include "state.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using QValues = std::array<int,4>; ///< One Q-value per action (UP, RIGHT, DOWN, LEFT).
+
+/**
+ * @brief How argmax4() picks among actions sharing the best Q-value.
+ */
+enum TieBreak {
+    TIE_RANDOM, ///< Uniformly at random (one draw of the thread's generator).
+    TIE_FIRST,  ///< Lowest action index, for reproducible runs.
+};
+
+/**
+ * @brief Bit mask of the actions holding the largest value of `q`.
+ *
+ * Bit i is set when q[i] is a maximum. Uses SSE2 compare / movemask when
+ * available; neither version branches or allocates.
+ */
+inline unsigned tie_mask4(const QValues& q) {
+#if defined(__SSE2__)
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q.data()));
+    __m128i o = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128i gt = _mm_cmpgt_epi32(v, o);
+    const __m128i m2 = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, o)); // max of each pair
+    o = _mm_shuffle_epi32(m2, _MM_SHUFFLE(1, 0, 3, 2));
+    gt = _mm_cmpgt_epi32(m2, o);
+    const __m128i m4 = _mm_or_si128(_mm_and_si128(gt, m2), _mm_andnot_si128(gt, o)); // max in every lane
+    return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, m4)));
+#else
+    const int m = std::max(std::max(q[0], q[1]), std::max(q[2], q[3]));
+    return (unsigned)(q[0] == m) | (unsigned)(q[1] == m) << 1 | (unsigned)(q[2] == m) << 2 | (unsigned)(q[3] == m) << 3;
+#endif
+}
+
+/**
+ * @brief Index of the best action in `q`.
+ *
+ * @param ties How to choose among equal best values.
+ */
+int argmax4(const QValues& q, TieBreak ties = TIE_RANDOM);
+
+/**
+ * @brief Dense Q-table indexed by State::index().
+ *
+ * Every possible state has its slot from the start, so a lookup is one array
+ * access with no hashing and no insertion. `visits` counts the updates made
+ * to each state; it backs size() and lets tables be merged by visit count.
+ *
+ * load() / store() / visit() use relaxed atomic accesses so several trainer
+ * threads can share one table Hogwild-style: a value is never torn, but
+ * concurrent updates of the same entry may overwrite each other. On x86 and
+ * ARM these compile to plain loads and stores.
+ */
+struct QTable {
+    std::vector<QValues> q;       ///< Q-values, one entry per state index.
+    std::vector<uint32_t> visits; ///< Number of updates per state index.
+    size_t count = 0;             ///< Number of states updated at least once.
+
+    /**
+     * @brief Create a zeroed table.
+     *
+     * @param states Number of state indices (State::COUNT by default).
+     */
+    explicit QTable(size_t states = State::COUNT)
+        : q(states, QValues{0, 0, 0, 0}), visits(states, 0) {}
+
+    size_t size() const { return __atomic_load_n(&count, __ATOMIC_RELAXED); } ///< Number of states updated so far.
+    size_t capacity() const { return q.size(); }  ///< Number of state indices.
+
+    QValues& ref(uint32_t idx) { return q[idx]; }             ///< Q-values of state `idx`.
+    const QValues& ref(uint32_t idx) const { return q[idx]; } ///< Q-values of state `idx`.
+
+    /**
+     * @brief Relaxed atomic copy of the Q-values of state `idx`.
+     */
+    QValues load(uint32_t idx) const {
+        QValues v;
+        for (int a = 0; a < 4; ++a) v[a] = __atomic_load_n(&q[idx][a], __ATOMIC_RELAXED);
+        return v;
+    }
+
+    /**
+     * @brief Relaxed atomic read of Q(idx, a).
+     */
+    int load(uint32_t idx, int a) const { return __atomic_load_n(&q[idx][a], __ATOMIC_RELAXED); }
+
+    /**
+     * @brief Relaxed atomic write of Q(idx, a).
+     */
+    void store(uint32_t idx, int a, int value) { __atomic_store_n(&q[idx][a], value, __ATOMIC_RELAXED); }
+
+    /**
+     * @brief Record one update of state `idx`.
+     */
+    void visit(uint32_t idx) {
+        if (__atomic_fetch_add(&visits[idx], 1u, __ATOMIC_RELAXED) == 0) {
+            __atomic_fetch_add(&count, (size_t)1, __ATOMIC_RELAXED);
+        }
+    }
+
+    /**
+     * @brief Reset every Q-value and visit count to zero.
+     */
+    void clear() {
+        std::fill(q.begin(), q.end(), QValues{0, 0, 0, 0});
+        std::fill(visits.begin(), visits.end(), 0);
+        count = 0;
+    }
+};
+
+#endif
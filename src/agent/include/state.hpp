@@ -0,0 +1,174 @@
+#ifndef STATE_HPP
+#define STATE_HPP
+
+#include "engine.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Rank of every green / red sensor combination that can occur.
+ *
+ * A combination is the four per-direction buckets (0..4) read as base-5
+ * digits UP + 5 * RIGHT + 25 * DOWN + 125 * LEFT. There are two green apples
+ * and one red apple, so at most two green digits and one red digit are
+ * non-zero; those combinations get consecutive ranks and the others -1.
+ */
+struct StateRanks {
+    static constexpr int CODES = 625;      ///< 5^4 possible combinations.
+    static constexpr int GREEN_COUNT = 113; ///< Combinations with <= 2 non-zero digits.
+    static constexpr int RED_COUNT = 17;    ///< Combinations with <= 1 non-zero digit.
+
+    int16_t green[CODES]{}; ///< Code -> green rank, or -1.
+    int16_t red[CODES]{};   ///< Code -> red rank, or -1.
+
+    constexpr StateRanks() {
+        int g = 0, r = 0;
+        for (int c = 0; c < CODES; ++c) {
+            int nonzero = 0;
+            for (int v = c; v > 0; v /= 5) nonzero += (v % 5) != 0;
+            green[c] = nonzero <= 2 ? g++ : -1;
+            red[c] = nonzero <= 1 ? r++ : -1;
+        }
+    }
+};
+
+inline constexpr StateRanks STATE_RANKS{}; ///< Rank tables, built at compile time.
+
+static_assert(STATE_RANKS.green[600] == StateRanks::GREEN_COUNT - 1, "GREEN_COUNT out of sync"); // 600 = 4*125 + 4*25
+static_assert(STATE_RANKS.red[500] == StateRanks::RED_COUNT - 1, "RED_COUNT out of sync");       // 500 = 4*125
+
+/**
+ * @struct State
+ * @brief Data structure for training the snake agent.
+ *
+ * Contains sensory inputs about dangers and food in all four directions,
+ * as well as the nearest green food direction.
+ */
+struct State {
+    // Distances to walls / body / food in 4 directions
+    // 0 = none, 1 = distance 1, 2 = distance 2-3, 3 = distance 4-7, 4 = distance 8+
+    uint8_t danger_up, danger_down, danger_left, danger_right;
+    uint8_t green_up, green_down, green_left, green_right;
+    uint8_t red_up, red_down, red_left, red_right;
+    uint8_t nearest_green_dir; // 0..4 (none, up, right, down, left)
+    uint8_t nearest_green_dist; // 0 = none, 1 = distance 1, 2 = distance 2-3, 3 = distance 4-7, 4 = distance 8+
+
+    State(std::vector<std::string> head_vision) {
+        uint8_t snake_up = string_analyze(head_vision[0], 'S');
+        uint8_t snake_right = string_analyze(head_vision[1], 'S');
+        uint8_t snake_down = string_analyze(head_vision[2], 'S');
+        uint8_t snake_left = string_analyze(head_vision[3], 'S');
+
+        uint8_t wall_up = string_analyze(head_vision[0], 'W');
+        uint8_t wall_right = string_analyze(head_vision[1], 'W');
+        uint8_t wall_down = string_analyze(head_vision[2], 'W');
+        uint8_t wall_left = string_analyze(head_vision[3], 'W');
+
+        danger_up = std::min(snake_up, wall_up);
+        danger_right = std::min(snake_right, wall_right);
+        danger_down = std::min(snake_down, wall_down);
+        danger_left = std::min(snake_left, wall_left);
+
+        green_up = string_analyze(head_vision[0], 'G');
+        green_right = string_analyze(head_vision[1], 'G');
+        green_down = string_analyze(head_vision[2], 'G');
+        green_left = string_analyze(head_vision[3], 'G');
+
+        red_up = string_analyze(head_vision[0], 'R');
+        red_right = string_analyze(head_vision[1], 'R');
+        red_down = string_analyze(head_vision[2], 'R');
+        red_left = string_analyze(head_vision[3], 'R');
+
+        // Nearest green direction
+        nearest_green_dir = 0;
+        nearest_green_dist = 15;
+        for (int dir = 0; dir < 4; ++dir) {
+            int dist = string_analyze(head_vision[dir], 'G');
+            if (dist > 0 && dist < nearest_green_dist) {
+                nearest_green_dist = dist;
+                nearest_green_dir = dir + 1; // +1 to make room for "none" = 0
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Build the state from first-hit sensor distances, with no strings.
+     *
+     * Gives the same fields as the vision-string constructor.
+     */
+    explicit State(const Sensors& s) {
+        danger_up = std::min(bucket(s.body[0]), bucket(s.wall[0]));
+        danger_right = std::min(bucket(s.body[1]), bucket(s.wall[1]));
+        danger_down = std::min(bucket(s.body[2]), bucket(s.wall[2]));
+        danger_left = std::min(bucket(s.body[3]), bucket(s.wall[3]));
+
+        green_up = bucket(s.green[0]);
+        green_right = bucket(s.green[1]);
+        green_down = bucket(s.green[2]);
+        green_left = bucket(s.green[3]);
+
+        red_up = bucket(s.red[0]);
+        red_right = bucket(s.red[1]);
+        red_down = bucket(s.red[2]);
+        red_left = bucket(s.red[3]);
+
+        // Nearest green direction: first ray (UP, RIGHT, DOWN, LEFT) seeing one
+        nearest_green_dir = 0;
+        nearest_green_dist = 15;
+        for (int dir = 0; dir < 4; ++dir) {
+            if (s.green[dir]) {
+                nearest_green_dist = bucket(s.green[dir]);
+                nearest_green_dir = dir + 1;
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief State of `env` in one pass over its sensor rays.
+     */
+    static State from_engine(const Engine& env) { return State(env.sense()); }
+
+    /**
+     * @brief Distance bucket of a first-hit distance: 0 none, then 1 / 2-3 / 4-7 / 8+ -> 1..4.
+     */
+    static uint8_t bucket(uint8_t dist) {
+        return dist ? (uint8_t)std::min(4, 32 - __builtin_clz(dist)) : 0;
+    }
+
+    static uint8_t string_analyze(const std::string& s, char target) {
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] == target) {
+                if (i == 0) return 1;
+                else if (i <= 2) return 2;
+                else if (i <= 6) return 3;
+                else return 4;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Dense index of this state in [0, State::COUNT).
+     *
+     * Mixed-radix encoding: the four danger fields are base-5 digits, and the
+     * green / red fields are ranked among the combinations the board allows
+     * (at most two directions see a green apple, at most one sees the red
+     * one). nearest_green_dir is not encoded since it follows from the green
+     * fields, and nearest_green_dist never was part of the key.
+     */
+    uint32_t index() const {
+        const uint32_t danger = danger_up + 5 * (danger_right + 5 * (danger_down + 5 * danger_left));
+        const int green = STATE_RANKS.green[green_up + 5 * (green_right + 5 * (green_down + 5 * green_left))];
+        const int red = STATE_RANKS.red[red_up + 5 * (red_right + 5 * (red_down + 5 * red_left))];
+        return (danger * StateRanks::GREEN_COUNT + green) * StateRanks::RED_COUNT + red;
+    }
+
+    static constexpr uint32_t VERSION = 1; ///< Version of index(); bump when the encoding changes so saved models are rejected.
+    static constexpr uint32_t COUNT = (uint32_t)StateRanks::CODES * StateRanks::GREEN_COUNT * StateRanks::RED_COUNT; ///< Number of state indices.
+};
+
+#endif
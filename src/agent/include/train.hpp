@@ -3,17 +3,190 @@
 
 #include "learn2slither.hpp"
 #include "engine.hpp"
+#include "qtable.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Live counters of a training run.
+ *
+ * Written by the training thread and read by any other thread through
+ * lock-free atomics, so a UI can poll it every frame.
+ */
+struct TrainProgress {
+    std::atomic<int> episode{0};             ///< Episodes finished so far.
+    std::atomic<int> episodes{0};            ///< Episodes requested for this run.
+    std::atomic<double> epsilon{0.0};        ///< Current exploration rate.
+    std::atomic<int> best_length{0};         ///< Longest snake seen so far.
+    std::atomic<long long> steps{0};         ///< Environment steps taken.
+    std::atomic<double> steps_per_sec{0.0};  ///< Average steps per second since start.
+    std::atomic<long long> qtable_size{0};   ///< Number of states in the Q-table.
+    std::atomic<int> looped{0};              ///< Episodes ended early because the board repeated.
+    std::atomic<bool> running{false};        ///< A run is in progress.
+    std::atomic<bool> cancel{false};         ///< Set to ask the run to stop early.
+};
+
+/**
+ * @brief Settings of a training run, editable from Python as Train.config.
+ */
+struct TrainConfig {
+    int episodes = 20000;   ///< Episodes to play, shared among all threads.
+    int grid = 10;          ///< Board size.
+    double alpha = 0.6;     ///< Learning rate.
+    double gamma = 0.85;    ///< Discount factor.
+    double eps_start = 0.9; ///< Exploration rate of the first episode.
+    double eps_end = 0.001; ///< Floor of the exploration rate.
+    int threads = 1;        ///< Worker threads.
+    int merge_every = 0;    ///< Episodes per worker between shard merges, 0 to share one Q-table (Hogwild).
+    bool random_ties = true; ///< Break greedy ties at random; false takes the lowest action (reproducible).
+    uint64_t seed = 42;     ///< Seed of the boards and of the action choices.
+    bool quiet = false;     ///< Do not print progress to stdout.
+    bool stop_loops = true; ///< End an episode when deterministic moves repeat the board (no apple, exploration or random tie in between).
+    double loop_penalty = -100.0; ///< Reward of the move that closes such a loop; unlike a collision it still bootstraps.
+
+    static constexpr int MAX_THREADS = 256; ///< Upper bound accepted for `threads`.
+};
+
+/**
+ * @brief Check that `cfg` describes a run that can be played.
+ *
+ * @throws std::runtime_error naming the first invalid setting.
+ */
+void check_config(const TrainConfig& cfg);
+
+/**
+ * @brief Plain copy of TrainProgress, as returned by Train::poll().
+ */
+struct TrainStatus {
+    int episode;
+    int episodes;
+    double epsilon;
+    int best_length;
+    long long steps;
+    double steps_per_sec;
+    long long qtable_size;
+    int looped;
+    bool running;
+    bool cancelled;
+    std::string error; ///< Why the last run failed, empty if it did not.
+};
+
+/**
+ * @brief Play the episodes of a run on `cfg.threads` threads (blocking).
+ *
+ * Workers share `Q` directly (Hogwild) unless `cfg.merge_every` is set, in
+ * which case they learn into private shards merged into `Q` periodically.
+ * This is the training part of Train::train(), without the test runs.
+ */
+void train_logic(QTable& Q, const TrainConfig& cfg, TrainProgress& progress);
+
+/**
+ * @brief Scores of a greedy policy over several games, see evaluate().
+ */
+struct EvalResult {
+    int games;          ///< Games played.
+    double mean_length; ///< Average final snake length.
+    int max_length;     ///< Longest final snake.
+    int truncated;      ///< Games stopped by a loop or the step cap instead of a game over.
+};
+
+/**
+ * @brief Play `games` greedy games (no exploration) with the policy of `Q`.
+ *
+ * Games run on one board seeded with `seed`, so the result is reproducible
+ * with TIE_FIRST. A game stops when the board repeats without an apple
+ * eaten or a tie broken at random in between (a deterministic policy would
+ * loop forever) or after `max_steps` steps.
+ */
+EvalResult evaluate(const QTable& Q, int grid, int games, uint64_t seed,
+                    TieBreak ties = TIE_FIRST, int max_steps = 10000);
 
 /**
  * @brief Lightweight wrapper so Python can do: agent.Train().train()
+ *
+ * A run can also be started in a background thread with start() and then
+ * followed with poll(), stopped with cancel() and waited for with join().
+ * The settings are read from `config` when a run starts. A run keeps
+ * learning into `qtable`, which starts empty or holds a loaded model.
  */
 struct Train {
+    TrainConfig config;     ///< Settings used by the next run.
+    QTable qtable;          ///< Q-table trained by the runs.
+    TrainProgress progress; ///< Counters of the current / last run.
+    std::thread worker;     ///< Background run started by start().
+
+    Train() = default;
+    Train(const Train&) = delete;
+    Train& operator=(const Train&) = delete;
+
+    /**
+     * @brief Cancel and join a background run still in progress.
+     */
+    ~Train();
 
     /**
-     * @brief Train the snake agent using Q-learning.
+     * @brief Train the snake agent using Q-learning (blocking).
+     *
+     * @throws std::runtime_error if a run is already in progress, the
+     *         settings are invalid or the run fails.
      */
     void train();
+
+    /**
+     * @brief Start train() on a background thread and return immediately.
+     *
+     * If the run fails later, poll() reports why in TrainStatus::error.
+     *
+     * @throws std::runtime_error if a run is already in progress or the
+     *         settings are invalid.
+     */
+    void start();
+
+    /**
+     * @brief Snapshot of the live counters.
+     */
+    TrainStatus poll() const;
+
+    /**
+     * @brief Ask the current run to stop after the episode in progress.
+     */
+    void cancel();
+
+    /**
+     * @brief Wait for the background run to finish (no-op if none).
+     */
+    void join();
+
+    /**
+     * @brief Save the Q-table and the run settings to a model file.
+     *
+     * @throws std::runtime_error if a run is in progress or on I/O errors.
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * @brief Load a model file saved by save(); also restores the settings.
+     *
+     * @throws std::runtime_error if a run is in progress or the file is invalid.
+     */
+    void load(const std::string& path);
+
+private:
+    mutable std::mutex error_lock; ///< Guards `error`.
+    std::string error;             ///< Why the last run failed, empty if it did not.
+
+    /// Training body shared by train() and start(); never throws.
+    void run(TrainConfig cfg);
+
+    /// Zero the counters of `progress` for a run of `cfg`.
+    void reset_progress(const TrainConfig& cfg);
+
+    /// Record why the current run failed ("" when starting a new one).
+    void set_error(const std::string& what);
 };
 
 
-#endif
\ No newline at end of file
+#endif
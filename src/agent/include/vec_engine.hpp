@@ -0,0 +1,68 @@
+#ifndef VEC_ENGINE_HPP
+#define VEC_ENGINE_HPP
+
+#include "learn2slither.hpp"
+#include "engine.hpp"
+#include "state.hpp"
+
+/**
+ * @brief Batch of N independent boards stepped together in one call.
+ *
+ * Every board is a full Engine (body ring, bitboards and free-cell index are
+ * variable-size per grid), while everything that crosses the step boundary
+ * is kept as contiguous per-field arrays (structure of arrays) so callers can
+ * hand them to NumPy without reshuffling.
+ *
+ * Finished boards are reset automatically at the end of step(); their
+ * `dones` / `lengths` entries still describe the episode that just ended while
+ * `sensors` already describes the fresh board.
+ */
+struct VecEngine {
+    static constexpr int SENSOR_COUNT = 16; ///< Values per board in `sensors`.
+
+    int n = 0;     ///< Number of boards.
+    int grid = 10; ///< Grid size shared by all boards.
+    Rewards rewards_table; ///< Reward given for each move result.
+
+    std::vector<Engine> envs; ///< The boards themselves.
+
+    // per-step outputs, one entry per board
+    std::vector<int8_t> results;   ///< MOVE_RESULT of the last step.
+    std::vector<float> rewards;    ///< Reward of the last step.
+    std::vector<uint8_t> dones;    ///< 1 if the last step ended the episode.
+    std::vector<int32_t> lengths;  ///< Snake length after the last step.
+    std::vector<uint8_t> sensors;  ///< n * SENSOR_COUNT first-hit distances (see Sensors).
+    std::vector<int32_t> episodes; ///< Number of finished episodes per board.
+
+    /**
+     * @brief Create `n` boards of size `grid`.
+     *
+     * Board i draws from stream i of `seed` (see Rng::jump()), so the boards
+     * do not play the same game.
+     *
+     * @param n Number of boards.
+     * @param grid Grid size.
+     * @param seed Base seed for the boards' RNGs.
+     */
+    VecEngine(int n, int grid, uint64_t seed = 42);
+
+    /**
+     * @brief Reset every board and refresh `sensors` / `lengths`.
+     */
+    void reset();
+
+    /**
+     * @brief Apply one action per board and advance all boards one step.
+     *
+     * @param actions `n` actions, 0 = UP, 1 = RIGHT, 2 = DOWN, 3 = LEFT.
+     */
+    void step(const int* actions);
+
+private:
+    std::vector<uint8_t> green_dist; ///< State::nearest_green_dist of each board, for reward shaping.
+
+    /// Write the sensors of board `i` into its row of `sensors`.
+    void write_sensors(int i);
+};
+
+#endif
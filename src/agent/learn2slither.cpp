@@ -6,13 +6,65 @@
  *    - reset the board,
  *    - move the snake forward one step,
  *    - change the direction safely (no instant reversal into the neck),
- *    - fetch the current board snapshot (snake, apples, flags).
+ *    - fetch the current board snapshot (snake, apples, flags),
+ *    - step a whole batch of boards at once (VecEngine).
  *
  */
 
 #include "include/learn2slither.hpp"
 #include "include/engine.hpp"
 #include "include/train.hpp"
+#include "include/vec_engine.hpp"
+#include "include/policy.hpp"
+#include <pybind11/numpy.h>
+#include <stdexcept>
+#include <unordered_map>
+
+
+/**
+ * @brief Clear the WRITEABLE flag of a view into engine memory.
+ *
+ * Writing through it would desync the board / body from the bitboards and
+ * the free-cell index, so Python only gets to read.
+ */
+template <typename T>
+static py::array_t<T> read_only(py::array_t<T> view) {
+    view.attr("setflags")(false);
+    return view;
+}
+
+/// Live board_array() / snake_array() views per engine (only touched with the GIL held).
+static std::unordered_map<const Engine*, int> engine_views;
+
+/**
+ * @brief Base object of a view into the memory of the Engine `self`.
+ *
+ * Keeps the engine alive and counts the view in `engine_views` until NumPy
+ * drops it (slices included), so a grid change can be refused meanwhile.
+ */
+static py::capsule pin_engine(py::object self) {
+    struct Pin { py::object owner; const Engine* engine; };
+    const Engine* e = &self.cast<const Engine&>();
+    ++engine_views[e];
+    return py::capsule(new Pin{self, e}, [](void* p) {
+        Pin* pin = static_cast<Pin*>(p);
+        if (--engine_views[pin->engine] == 0) engine_views.erase(pin->engine);
+        delete pin;
+    });
+}
+
+/**
+ * @brief Throw if giving `e` a `grid` board would free memory a live view reads.
+ *
+ * The board and the body ring are sized grid * grid, so a new grid size
+ * reallocates them.
+ */
+static void check_grid_change(const Engine& e, int grid) {
+    if (grid != e.grid && engine_views.count(&e)) {
+        throw std::runtime_error("cannot change the grid size while board_array() / snake_array() views "
+                                 "of this engine are alive");
+    }
+}
 
 
 /**
@@ -22,20 +74,179 @@
  *   - reset_board(grid:int)
  *   - change_dir(new_dir: Engine.Dir)
  *   - step_forward()
+ *   - step(action:int) -> StepInfo
  *   - get_board() -> dict
- *   - train()
+ *   - board_array() / snake_array() -> zero-copy read-only NumPy views
+ *   - VecEngine(n, grid, seed).reset() / .step(actions) / .lengths()
+ *   - train(), or start() / poll() / cancel() / join() in the background
+ *   - save(path) / load(path) for binary model files
+ *   - Policy(path).act(engine) for a memory-mapped read-only model
+ *   - snapshot() / snapshot_into(snap) / restore(snap) / clone() to branch games
+ *   - make_move(action) -> MoveUndo / unmake_move(undo) for depth-first search
+ *   - hash() -> 64-bit Zobrist hash of the board, for transposition tables
+ *   - Train.config.threads = n for Hogwild training on n threads, plus
+ *     Train.config.merge_every = k for private shards merged every k episodes
  */
 PYBIND11_MODULE(_agent, m) {
+    // Long-running or bulk calls below release the GIL (call_guard / scoped
+    // release) so UI and monitoring threads keep running and several engines
+    // can be driven from different Python threads. A single Engine, VecEngine
+    // or Train object must still only be used by one thread at a time.
+
     m.doc() = "Learn2Slither C++ agent exposed to Python via pybind11";
 
-    py::class_<Engine>(m, "Engine")
+    py::enum_<CellCode>(m, "Cell")
+        .value("EMPTY", CELL_EMPTY)
+        .value("SNAKE", CELL_SNAKE)
+        .value("HEAD", CELL_HEAD)
+        .value("GREEN", CELL_GREEN)
+        .value("RED", CELL_RED);
+
+    py::enum_<MOVE_RESULT>(m, "MoveResult")
+        .value("OK", MOVE_OK)
+        .value("COLLISION", MOVE_COLLISION)
+        .value("RED_APPLE", MOVE_RED_APPLE)
+        .value("GREEN_APPLE", MOVE_GREEN_APPLE);
+
+    py::class_<StepInfo>(m, "StepInfo")
+        .def_readonly("result", &StepInfo::result)
+        .def_readonly("ate_green", &StepInfo::ate_green)
+        .def_readonly("ate_red", &StepInfo::ate_red)
+        .def_readonly("done", &StepInfo::done)
+        .def_readonly("length", &StepInfo::length);
+
+    py::class_<EngineSnapshot>(m, "EngineSnapshot")
         .def(py::init<>())
-        .def("reset_board", &Engine::reset_board, py::arg("grid"))
-        .def("step_forward", &Engine::step_forward)
+        .def_readonly("grid", &EngineSnapshot::grid)
+        .def_property_readonly("length", [](const EngineSnapshot& s) { return s.body.size(); })
+        .def_readonly("game_over", &EngineSnapshot::game_over);
+
+    py::class_<MoveUndo>(m, "MoveUndo")
+        .def_readonly("result", &MoveUndo::result)
+        .def_readonly("moved", &MoveUndo::moved);
+
+    py::class_<Engine>(m, "Engine")
+        .def(py::init<uint64_t>(), py::arg("seed") = 42)
+        .def("seed", [](Engine& e, uint64_t seed) { e.rng_engine.seed(seed); }, py::arg("seed"))
+        .def("reset_board", [](Engine& e, int grid) {
+            check_grid_change(e, grid);
+            py::gil_scoped_release release;
+            e.reset_board(grid);
+        }, py::arg("grid"), "new game on a grid x grid board; RuntimeError if views hold another grid size")
+        .def("step_forward", &Engine::step_forward, py::arg("printing") = true,
+             py::call_guard<py::gil_scoped_release>())
+        .def("step", &Engine::step, py::arg("action"))
         .def("change_dir", &Engine::change_dir, py::arg("new_dir"))
-        .def("get_board", &Engine::get_board);
+        .def("get_board", &Engine::get_board)
+        .def("snapshot", py::overload_cast<>(&Engine::snapshot, py::const_))
+        .def("snapshot_into", py::overload_cast<EngineSnapshot&>(&Engine::snapshot, py::const_), py::arg("snap"))
+        .def("restore", [](Engine& e, const EngineSnapshot& snap) {
+            check_grid_change(e, snap.grid);
+            e.restore(snap);
+        }, py::arg("snap"), "copy `snap` back; RuntimeError if views hold another grid size")
+        .def("clone", [](const Engine& e) { return Engine(e); })
+        .def("make_move", &Engine::make_move, py::arg("action"))
+        .def("unmake_move", &Engine::unmake_move, py::arg("undo"))
+        .def("hash", &Engine::hash, "64-bit Zobrist hash of the snake, apples and head direction")
+        // Both views are read-only and alias engine memory. Their base pins the
+        // engine: it stays alive, and reset_board() / restore() to another grid
+        // size (which would reallocate that memory) raise while a view exists.
+        // The board view sees later moves. The snake view is a fixed window on
+        // the body ring: it is only valid until the next move and must be
+        // fetched again after every move.
+        .def("board_array", [](py::object self) {
+            const Engine& e = self.cast<const Engine&>();
+            return read_only(py::array_t<uint8_t>({e.grid, e.grid}, e.board.data(), pin_engine(self)));
+        }, "read-only (grid, grid) uint8 array of Cell codes, indexed [y, x]; while it is alive, "
+           "reset_board() / restore() to another grid size raise RuntimeError")
+        .def("snake_array", [](py::object self) {
+            const Engine& e = self.cast<const Engine&>();
+            static_assert(sizeof(std::pair<int,int>) == 2 * sizeof(int), "pair<int,int> must be two packed ints");
+            return read_only(py::array_t<int>({e.snake.size(), 2}, &e.snake.data()->first, pin_engine(self)));
+        }, "read-only (length, 2) int array of (x, y) body cells, head first; fetch again after every move. "
+           "While it is alive, reset_board() / restore() to another grid size raise RuntimeError");
+
+    py::class_<VecEngine>(m, "VecEngine")
+        .def(py::init<int, int, uint64_t>(), py::arg("n"), py::arg("grid") = 10, py::arg("seed") = 42)
+        .def_readonly("n", &VecEngine::n)
+        .def_readonly("grid", &VecEngine::grid)
+        .def("reset", [](VecEngine& v) {
+            {
+                py::gil_scoped_release release;
+                v.reset();
+            }
+            return py::array_t<uint8_t>({v.n, VecEngine::SENSOR_COUNT}, v.sensors.data());
+        })
+        .def("step", [](VecEngine& v, py::array_t<int, py::array::c_style | py::array::forcecast> actions) {
+            if (actions.size() != v.n) {
+                throw std::invalid_argument("step() expects one action per board");
+            }
+            const int* acts = actions.data();
+            {
+                py::gil_scoped_release release;
+                v.step(acts);
+            }
+            return py::make_tuple(
+                py::array_t<float>(v.n, v.rewards.data()),
+                py::array_t<bool>(v.n, reinterpret_cast<const bool*>(v.dones.data())),
+                py::array_t<uint8_t>({v.n, VecEngine::SENSOR_COUNT}, v.sensors.data()));
+        }, py::arg("actions"))
+        .def("lengths", [](const VecEngine& v) {
+            return py::array_t<int32_t>(v.n, v.lengths.data());
+        })
+        .def("episodes", [](const VecEngine& v) {
+            return py::array_t<int32_t>(v.n, v.episodes.data());
+        });
+
+    py::class_<TrainConfig>(m, "TrainConfig")
+        .def(py::init<>())
+        .def_readwrite("episodes", &TrainConfig::episodes)
+        .def_readwrite("grid", &TrainConfig::grid)
+        .def_readwrite("alpha", &TrainConfig::alpha)
+        .def_readwrite("gamma", &TrainConfig::gamma)
+        .def_readwrite("eps_start", &TrainConfig::eps_start)
+        .def_readwrite("eps_end", &TrainConfig::eps_end)
+        .def_readwrite("threads", &TrainConfig::threads)
+        .def_readwrite("merge_every", &TrainConfig::merge_every)
+        .def_readwrite("random_ties", &TrainConfig::random_ties)
+        .def_readwrite("seed", &TrainConfig::seed)
+        .def_readwrite("quiet", &TrainConfig::quiet)
+        .def_readwrite("stop_loops", &TrainConfig::stop_loops)
+        .def_readwrite("loop_penalty", &TrainConfig::loop_penalty);
+
+    py::class_<TrainStatus>(m, "TrainStatus")
+        .def_readonly("episode", &TrainStatus::episode)
+        .def_readonly("episodes", &TrainStatus::episodes)
+        .def_readonly("epsilon", &TrainStatus::epsilon)
+        .def_readonly("best_length", &TrainStatus::best_length)
+        .def_readonly("steps", &TrainStatus::steps)
+        .def_readonly("steps_per_sec", &TrainStatus::steps_per_sec)
+        .def_readonly("qtable_size", &TrainStatus::qtable_size)
+        .def_readonly("looped", &TrainStatus::looped)
+        .def_readonly("running", &TrainStatus::running)
+        .def_readonly("cancelled", &TrainStatus::cancelled)
+        .def_readonly("error", &TrainStatus::error);
 
     py::class_<Train>(m, "Train")
         .def(py::init<>())
-        .def("train", &Train::train);
+        .def_readwrite("config", &Train::config)
+        .def("train", &Train::train, py::call_guard<py::gil_scoped_release>())
+        .def("start", &Train::start)
+        .def("poll", &Train::poll)
+        .def("cancel", &Train::cancel)
+        .def("join", &Train::join, py::call_guard<py::gil_scoped_release>())
+        .def("save", &Train::save, py::arg("path"), py::call_guard<py::gil_scoped_release>())
+        .def("load", &Train::load, py::arg("path"), py::call_guard<py::gil_scoped_release>());
+
+    py::class_<Policy>(m, "Policy")
+        .def(py::init<const std::string&>(), py::arg("path"))
+        .def("__len__", &Policy::size)
+        .def_property_readonly("grid", [](const Policy& p) { return p.header().grid; })
+        .def("act", [](const Policy& p, const Engine& e, bool random_ties) {
+            return p.act(State::from_engine(e), random_ties ? TIE_RANDOM : TIE_FIRST);
+        }, py::arg("engine"), py::arg("random_ties") = true)
+        .def("q_values", [](const Policy& p, const Engine& e) {
+            const QValues q = p.lookup(State::from_engine(e).index());
+            return py::make_tuple(q[0], q[1], q[2], q[3]);
+        }, py::arg("engine"));
 }
@@ -0,0 +1,140 @@
+#include "include/model.hpp"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+static_assert(sizeof(QValues) == 4 * sizeof(int32_t), "QValues must be four packed int32");
+static_assert(sizeof(ModelHeader) == 72, "ModelHeader must have no padding");
+
+/**
+ * @brief 64-bit FNV-1a hash of `size` bytes, continuing from `h`.
+ */
+static uint64_t fnv1a(const void* data, size_t size, uint64_t h = 1469598103934665603ull) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * @brief FNV-1a hash of `h` with its checksum field zeroed.
+ *
+ * The entry arrays are hashed on from there, so a damaged setting is caught
+ * as well as a damaged entry.
+ */
+static uint64_t header_hash(ModelHeader h) {
+    h.checksum = 0;
+    return fnv1a(&h, sizeof(h));
+}
+
+struct FileCloser {
+    void operator()(FILE* f) const { fclose(f); }
+};
+using File = std::unique_ptr<FILE, FileCloser>;
+
+void save_model(const std::string& path, const QTable& Q, const ModelInfo& info) {
+    std::vector<uint32_t> keys;
+    keys.reserve(Q.size());
+    for (uint32_t i = 0; i < Q.capacity(); ++i) {
+        if (Q.visits[i] > 0) keys.push_back(i);
+    }
+    const size_t n = keys.size();
+    std::vector<QValues> values(n);
+    std::vector<uint32_t> visits(n);
+    for (size_t k = 0; k < n; ++k) {
+        values[k] = Q.q[keys[k]];
+        visits[k] = Q.visits[keys[k]];
+    }
+
+    ModelHeader h{};
+    std::memcpy(h.magic, MODEL_MAGIC, sizeof(h.magic));
+    h.version = MODEL_VERSION;
+    h.state_version = State::VERSION;
+    h.grid = info.grid;
+    h.episodes = info.episodes;
+    h.alpha = info.alpha;
+    h.gamma = info.gamma;
+    h.eps_start = info.eps_start;
+    h.eps_end = info.eps_end;
+    h.count = n;
+    h.checksum = fnv1a(keys.data(), n * sizeof(uint32_t), header_hash(h));
+    h.checksum = fnv1a(values.data(), n * sizeof(QValues), h.checksum);
+    h.checksum = fnv1a(visits.data(), n * sizeof(uint32_t), h.checksum);
+
+    File f(fopen(path.c_str(), "wb"));
+    if (!f) throw std::runtime_error("cannot open model file for writing: " + path);
+    bool ok = fwrite(&h, sizeof(h), 1, f.get()) == 1;
+    if (n > 0) {
+        ok = ok && fwrite(keys.data(), sizeof(uint32_t), n, f.get()) == n
+                && fwrite(values.data(), sizeof(QValues), n, f.get()) == n
+                && fwrite(visits.data(), sizeof(uint32_t), n, f.get()) == n;
+    }
+    ok = fclose(f.release()) == 0 && ok;
+    if (!ok) throw std::runtime_error("cannot write model file: " + path);
+}
+
+ModelInfo load_model(const std::string& path, QTable& Q) {
+    File f(fopen(path.c_str(), "rb"));
+    if (!f) throw std::runtime_error("cannot open model file: " + path);
+
+    fseek(f.get(), 0, SEEK_END);
+    const long end = ftell(f.get());
+    fseek(f.get(), 0, SEEK_SET);
+    if (end < (long)sizeof(ModelHeader)) throw std::runtime_error("not a model file: " + path);
+
+    std::vector<char> buf((size_t)end);
+    if (fread(buf.data(), 1, buf.size(), f.get()) != buf.size()) {
+        throw std::runtime_error("cannot read model file: " + path);
+    }
+
+    ModelHeader h;
+    std::memcpy(&h, buf.data(), sizeof(h));
+    if (std::memcmp(h.magic, MODEL_MAGIC, sizeof(h.magic)) != 0) {
+        throw std::runtime_error("not a model file: " + path);
+    }
+    if (h.version != MODEL_VERSION) {
+        throw std::runtime_error("unsupported model file version " + std::to_string(h.version) + ": " + path);
+    }
+    if (h.state_version != State::VERSION) {
+        throw std::runtime_error("model uses another state encoding (version " + std::to_string(h.state_version) + "): " + path);
+    }
+    const uint64_t n = h.count;
+    const size_t entry = 2 * sizeof(uint32_t) + sizeof(QValues);
+    if (n > Q.capacity() || buf.size() != sizeof(h) + n * entry) {
+        throw std::runtime_error("truncated or oversized model file: " + path);
+    }
+
+    const char* keys = buf.data() + sizeof(h);
+    const char* values = keys + n * sizeof(uint32_t);
+    const char* visits = values + n * sizeof(QValues);
+    if (fnv1a(keys, n * entry, header_hash(h)) != h.checksum) {
+        throw std::runtime_error("model file checksum mismatch: " + path);
+    }
+
+    Q.clear();
+    for (uint64_t k = 0; k < n; ++k) {
+        uint32_t key, v;
+        std::memcpy(&key, keys + k * sizeof(uint32_t), sizeof(key));
+        std::memcpy(&v, visits + k * sizeof(uint32_t), sizeof(v));
+        if (key >= Q.capacity()) {
+            Q.clear();
+            throw std::runtime_error("model file has an invalid state index: " + path);
+        }
+        std::memcpy(&Q.q[key], values + k * sizeof(QValues), sizeof(QValues));
+        if (Q.visits[key] == 0 && v > 0) ++Q.count;
+        Q.visits[key] = v;
+    }
+
+    ModelInfo info;
+    info.grid = h.grid;
+    info.episodes = h.episodes;
+    info.alpha = h.alpha;
+    info.gamma = h.gamma;
+    info.eps_start = h.eps_start;
+    info.eps_end = h.eps_end;
+    return info;
+}
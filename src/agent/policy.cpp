@@ -0,0 +1,57 @@
+#include "include/policy.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Policy::Policy(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open model file: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ModelHeader)) {
+        close(fd);
+        throw std::runtime_error("not a model file: " + path);
+    }
+    map_size = (size_t)st.st_size;
+    map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (map == MAP_FAILED) {
+        map = nullptr;
+        throw std::runtime_error("cannot map model file: " + path);
+    }
+
+    hdr = static_cast<const ModelHeader*>(map);
+    std::string error;
+    if (std::memcmp(hdr->magic, MODEL_MAGIC, sizeof(hdr->magic)) != 0) {
+        error = "not a model file: ";
+    } else if (hdr->version != MODEL_VERSION) {
+        error = "unsupported model file version " + std::to_string(hdr->version) + ": ";
+    } else if (hdr->state_version != State::VERSION) {
+        error = "model uses another state encoding (version " + std::to_string(hdr->state_version) + "): ";
+    } else if (hdr->count > State::COUNT
+               || map_size != sizeof(ModelHeader) + hdr->count * (2 * sizeof(uint32_t) + sizeof(QValues))) {
+        error = "truncated or oversized model file: ";
+    }
+    if (!error.empty()) {
+        munmap(map, map_size);
+        map = nullptr;
+        throw std::runtime_error(error + path);
+    }
+
+    count = hdr->count;
+    keys = reinterpret_cast<const uint32_t*>(hdr + 1);
+    values = reinterpret_cast<const QValues*>(keys + count);
+}
+
+Policy::~Policy() {
+    if (map) munmap(map, map_size);
+}
+
+QValues Policy::lookup(uint32_t idx) const {
+    const uint32_t* it = std::lower_bound(keys, keys + count, idx);
+    if (it == keys + count || *it != idx) return QValues{0, 0, 0, 0};
+    return values[it - keys];
+}
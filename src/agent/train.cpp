@@ -1,281 +1,642 @@
 #include "include/train.hpp"
-#include <unordered_map>
+#include "include/state.hpp"
+#include "include/qtable.hpp"
+#include "include/model.hpp"
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
 
 
-std::mt19937 rng {std::random_device{}()}; //< Global random number generator
+thread_local Rng rng; //< Per-thread random number generator, seeded per worker
 
 /**
- * @struct State
- * @brief Data structure for training the snake agent.
+ * @brief Get the Q-values for a given state.
  *
- * Contains sensory inputs about dangers and food in all four directions,
- * as well as the nearest green food direction.
- */
-struct State {
-    // Distances to walls / body / food in 4 directions
-    // 0 = none, 1 = distance 1, 2 = distance 2-3, 3 = distance 4-7, 4 = distance 8+
-    uint8_t danger_up, danger_down, danger_left, danger_right;
-    uint8_t green_up, green_down, green_left, green_right;
-    uint8_t red_up, red_down, red_left, red_right;
-    uint8_t nearest_green_dir; // 0..4 (none, up, right, down, left)
-    uint8_t nearest_green_dist; // 0 = none, 1 = distance 1, 2 = distance 2-3, 3 = distance 4-7, 4 = distance 8+
-
-    State(std::vector<std::string> head_vision) {
-        uint8_t snake_up = string_analyze(head_vision[0], 'S');
-        uint8_t snake_right = string_analyze(head_vision[1], 'S');
-        uint8_t snake_down = string_analyze(head_vision[2], 'S');
-        uint8_t snake_left = string_analyze(head_vision[3], 'S');
-
-        uint8_t wall_up = string_analyze(head_vision[0], 'W');
-        uint8_t wall_right = string_analyze(head_vision[1], 'W');
-        uint8_t wall_down = string_analyze(head_vision[2], 'W');
-        uint8_t wall_left = string_analyze(head_vision[3], 'W');
-
-        danger_up = std::min(snake_up, wall_up);
-        danger_right = std::min(snake_right, wall_right);
-        danger_down = std::min(snake_down, wall_down);
-        danger_left = std::min(snake_left, wall_left);
-
-        green_up = string_analyze(head_vision[0], 'G');
-        green_right = string_analyze(head_vision[1], 'G');
-        green_down = string_analyze(head_vision[2], 'G');
-        green_left = string_analyze(head_vision[3], 'G');
-
-        red_up = string_analyze(head_vision[0], 'R');
-        red_right = string_analyze(head_vision[1], 'R');
-        red_down = string_analyze(head_vision[2], 'R');
-        red_left = string_analyze(head_vision[3], 'R');
-
-        // Nearest green direction
-        nearest_green_dir = 0;
-        nearest_green_dist = 15;
-        for (int dir = 0; dir < 4; ++dir) {
-            int dist = string_analyze(head_vision[dir], 'G');
-            if (dist > 0 && dist < nearest_green_dist) {
-                nearest_green_dist = dist;
-                nearest_green_dir = dir + 1; // +1 to make room for "none" = 0
-                break;
-            }
-        }
-    }
-
-    static uint8_t string_analyze(const std::string& s, char target) {
-        for (size_t i = 0; i < s.size(); ++i) {
-            if (s[i] == target) {
-                if (i == 0) return 1;
-                else if (i <= 2) return 2;
-                else if (i <= 6) return 3;
-                else return 4;
-            }
-        }
-        return 0;
-    }
-
-    uint64_t pack() const {
-        auto pack4 = [](uint8_t v)->uint64_t { return (uint64_t)(v & 0xF); };
-
-        uint64_t x = 0;
-        auto push = [&](uint8_t v){ x = (x << 4) | pack4(v); };
-
-        // order is arbitrary but must be consistent:
-        push(danger_up); push(danger_down); push(danger_left); push(danger_right);
-        push(green_up); push(green_down); push(green_left); push(green_right);
-        push(red_up); push(red_down); push(red_left); push(red_right);
-        push(nearest_green_dir);
-
-        return x;
-    }
-
-    bool operator==(const State& o) const { return pack() == o.pack(); }
-};
-
-/**
- * @struct StateHash
- * @brief Hash function for State to be used in unordered containers.
- */
-struct StateHash {
-  size_t operator()(State const& s) const noexcept {
-    return std::hash<uint64_t>{}(s.pack());
-  }
-};
-
-
-using QValues = std::array<int,4>;
-using QTable  = std::unordered_map<State, QValues, StateHash>;
-
-
-/**
- * @brief Get a reference to the Q-values for a given state, inserting default if missing.
- *
- * @param Q Q-table mapping states to Q-values.
+ * @param Q Q-table indexed by State::index() (a QTable, possibly shared with
+ *          other threads, or a ShardTable).
  * @param s State for which to retrieve the Q-values.
- * @return Reference to the Q-values array for the state.
+ * @return Copy of the Q-values array for the state.
  */
-inline QValues& qref(QTable& Q, const State& s) {
-    auto it = Q.find(s);
-    if (it == Q.end()) it = Q.emplace(s, QValues{0,0,0,0}).first;
-    return it->second;
+template <typename Table>
+inline QValues qref(const Table& Q, const State& s) {
+    return Q.load(s.index());
 }
 
-inline int argmax4(const QValues& q) {
-    std::vector<int> best = {0};
-    for (int i = 1; i < 4; ++i) {
-        if (q[i] > q[best[0]])
-            best[0] = i;
-        else if (q[i] == q[best[0]])
-            best.push_back(i);
-    }
-    if (best.size() == 1)
-        return best[0];
-    std::uniform_int_distribution<int> Bi(0, (int)best.size() - 1);
-    int idx = Bi(rng);
-    return best[idx];
+int argmax4(const QValues& q, TieBreak ties) {
+    unsigned mask = tie_mask4(q);
+    if (ties == TIE_FIRST) return __builtin_ctz(mask);
+
+    // pick the k-th of the n tied actions
+    const unsigned n = __builtin_popcount(mask);
+    unsigned k = rng.below(n);
+    while (k--) mask &= mask - 1; // drop the lowest set bit
+    return __builtin_ctz(mask);
 }
 
-inline int move_choice(QTable& Q, const State& s, double eps) {
-    std::uniform_real_distribution<double> u(0.0, 1.0);
-    if (u(rng) < eps) {
-        std::uniform_int_distribution<int> random_act(0,3);
-        return random_act(rng);
+// `random`, if given, tells whether the move was drawn at random: an
+// exploratory move or a greedy one picked among several tied actions.
+template <typename Table>
+inline int move_choice(const Table& Q, const State& s, double eps, TieBreak ties = TIE_RANDOM,
+                       bool* random = nullptr) {
+    const bool explore = rng.uniform() < eps;
+    if (random) *random = explore;
+    if (explore) {
+        return rng.below(4);
+    }
+    const QValues q = qref(Q, s);
+    if (random && ties == TIE_RANDOM) {
+        const unsigned mask = tie_mask4(q);
+        *random = (mask & (mask - 1)) != 0; // more than one best action
     }
-    return argmax4(qref(Q, s));
+    return argmax4(q, ties);
 }
 
 // One-step Q-learning update: Q(s,a) ← Q(s,a) + α [ r + γ max_a' Q(s',a') − Q(s,a) ]
-inline void q_update(QTable& Q,
+template <typename Table>
+inline void q_update(Table& Q,
                      const State& s, int a, double r,
                      const State& s2, bool done,
                      double alpha, double gamma) {
-    QValues& q = qref(Q, s);
-    double qsa = q[a];
+    const uint32_t i = s.index();
+    Q.visit(i);
+    double qsa = Q.load(i, a);
 
     double target;
     if (done) {
         target = r;
     } else {
-        const QValues& q2 = qref(Q, s2);
+        const QValues q2 = qref(Q, s2);
         target = r + gamma * *std::max_element(q2.begin(), q2.end());
     }
-    q[a] = qsa + alpha * (target - qsa);
+    Q.store(i, a, (int)(qsa + alpha * (target - qsa)));
 }
 
 struct StepResult {
     State s2;
     double r;
     bool done;
+    bool ate; ///< An apple was eaten (green or red).
 };
 
-// Map action index -> your engine’s direction
-inline void apply_action(Engine& env, int a) {
-    switch (a) {
-        case 0: env.change_dir("UP"); break;
-        case 1: env.change_dir("RIGHT"); break;
-        case 2: env.change_dir("DOWN"); break;
-        case 3: env.change_dir("LEFT"); break;
-    }
+/**
+ * @brief Play action `a` from state `s` (the current state of `env`).
+ */
+inline StepResult env_step(Engine& env, const State& s, int a) {
+    StepInfo info = env.step(a);
+    State s2 = State::from_engine(env);
+
+    const Rewards rw;
+    return { s2, rw.of(info.result, s.nearest_green_dist, s2.nearest_green_dist), info.done,
+             info.ate_green || info.ate_red };
 }
 
-inline StepResult env_step(Engine& env, int a) {
-    apply_action(env, a);
+/**
+ * @brief Board hashes seen since the last apple, to spot a looping snake.
+ *
+ * Nothing random happens between two apples, so once Engine::hash() repeats
+ * a policy that picks the same move in the same state would cycle forever.
+ * That only holds for deterministic moves: after an apple, an exploratory
+ * move or a tie broken at random the search starts over. Open addressing
+ * with an epoch tag per slot makes that clear() O(1) instead of wiping the
+ * table.
+ */
+struct LoopDetector {
+    std::vector<uint64_t> keys;  ///< Hashes, valid where tags[i] == epoch.
+    std::vector<uint32_t> tags;  ///< Epoch each slot was written in.
+    uint32_t epoch = 1;          ///< Current epoch, bumped by clear().
+    size_t count = 0;            ///< Hashes recorded in this epoch.
+
+    /// Forget every recorded hash.
+    void clear() {
+        count = 0;
+        if (++epoch == 0) { // wrapped: stale tags could match again
+            std::fill(tags.begin(), tags.end(), 0u);
+            epoch = 1;
+        }
+    }
 
-    State s = State(env.get_head_vision());
+    /// Record `h`; return false if it was already recorded since the last clear().
+    bool insert(uint64_t h) {
+        if (2 * (count + 1) > keys.size()) grow();
+        const size_t mask = keys.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) { // hashes are already well mixed
+            if (tags[i] != epoch) {
+                keys[i] = h;
+                tags[i] = epoch;
+                ++count;
+                return true;
+            }
+            if (keys[i] == h) return false;
+        }
+    }
 
-    MOVE_RESULT move_res = env.step_forward(false);
+    /// Start a new game on `env`.
+    void start(const Engine& env) {
+        clear();
+        insert(env.hash());
+    }
 
-    State s2 = State(env.get_head_vision());
+    /// Record the state of `env` after a move; true if the snake is looping.
+    /// `fresh` (an apple eaten, a move drawn at random) starts a new search.
+    bool looped(const Engine& env, bool fresh) {
+        if (fresh) clear();
+        return !insert(env.hash());
+    }
 
-    double r;
-    switch (move_res) {
-        case MOVE_RESULT::MOVE_OK:
-            if (s2.nearest_green_dist < s.nearest_green_dist && s2.nearest_green_dist > 0) {
-                r = +5.0; // getting closer to green apple
-            } else {
-                r = -0.1; // small penalty for normal move
-            }
-            break;
-        case MOVE_RESULT::MOVE_COLLISION:
-            r = -100.0;
-            break;
-        case MOVE_RESULT::MOVE_RED_APPLE:
-            r = -30.0;
-            break;
-        case MOVE_RESULT::MOVE_GREEN_APPLE:
-            r = +50.0;
-            break;
-        default:
-            r = -1.0;
-    }
-
-    return { s2, r, env.game_over };
-}
+private:
+    void grow() {
+        std::vector<uint64_t> old_keys(std::max<size_t>(64, 2 * keys.size()));
+        std::vector<uint32_t> old_tags(old_keys.size(), 0u);
+        old_keys.swap(keys);
+        old_tags.swap(tags);
+        const uint32_t live = epoch;
+        count = 0;
+        for (size_t i = 0; i < old_keys.size(); ++i) {
+            if (old_tags[i] == live) insert(old_keys[i]);
+        }
+    }
+};
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Play episode `ep` on `env`, learning into `Q`, and publish progress.
+ *
+ * The exploration rate only depends on the episode number, so the schedule
+ * is the same whatever the number of workers.
+ */
+template <typename Table>
+static void play_episode(Table& Q, Engine& env, const TrainConfig& cfg, int ep,
+                         TrainProgress& progress, Clock::time_point t0) {
+    if (!cfg.quiet && ep % 100 == 0) {
+        printf("Episode %d / %d\n", ep, cfg.episodes);
+    }
+
+    const double eps = std::max(cfg.eps_end, cfg.eps_start * std::pow(0.995, ep)); // decay epsilon
 
-inline void train_logic(QTable& Q, int episodes,
-           double alpha, double gamma,
-           double eps_start, double eps_end,
-           Engine& env, int grid) {
+    env.reset_board(cfg.grid);
 
-    int best_len = 0;
+    State s = State::from_engine(env);
 
-    double eps = eps_start;
+    static thread_local LoopDetector loops;
+    loops.start(env);
+    bool looped = false;
 
-    for (int ep = 0; ep < episodes; ++ep) {
-        if (ep % 100 == 0) {
-            printf("Episode %d / %d\n", ep, episodes);
+    int steps = 0;
+    const int max_steps = 10000; // safety cap per episode
+
+    while (!env.game_over && steps++ < max_steps) {
+        // choose action
+        bool random;
+        int a = move_choice(Q, s, eps, cfg.random_ties ? TIE_RANDOM : TIE_FIRST, &random);
+
+        // step env
+        StepResult tr = env_step(env, s, a);
+
+        // a board repeated through deterministic moves ends the episode; the
+        // closing move is penalized but still bootstraps from s2, since the
+        // game itself is not over (a truncation, not a terminal state)
+        if (cfg.stop_loops && !tr.done && loops.looped(env, tr.ate || random)) {
+            tr.r = cfg.loop_penalty;
+            looped = true;
         }
 
-        env.reset_board(grid);
+        // Q update
+        q_update(Q, s, a, tr.r, tr.s2, tr.done, cfg.alpha, cfg.gamma);
 
-        State s = State(env.get_head_vision());
+        // advance
+        s = tr.s2;
+        if (looped) break;
+    }
 
-        int steps = 0;
-        const int max_steps = 10000; // safety cap per episode
+    // publish progress
+    const int len = (int)env.snake.size();
+    int best = progress.best_length.load(std::memory_order_relaxed);
+    while (len > best && !progress.best_length.compare_exchange_weak(best, len, std::memory_order_relaxed)) {}
+    if (!cfg.quiet && ep % 1000 == 0) {
+        printf("  Best snake length so far: %d\n", std::max(best, len));
+    }
 
-        while (!env.game_over && steps++ < max_steps) {
-            // choose action
-            int a = move_choice(Q, s, eps);
+    const long long total_steps = progress.steps.fetch_add(std::min(steps, max_steps), std::memory_order_relaxed)
+                                + std::min(steps, max_steps);
+    const double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+    progress.steps_per_sec.store(elapsed > 0 ? total_steps / elapsed : 0.0, std::memory_order_relaxed);
+    progress.epsilon.store(eps, std::memory_order_relaxed);
+    progress.qtable_size.store((long long)Q.size(), std::memory_order_relaxed);
+    if (looped) progress.looped.fetch_add(1, std::memory_order_relaxed);
+    progress.episode.fetch_add(1, std::memory_order_relaxed);
+}
 
-            // step env
-            StepResult tr = env_step(env, a);
+/**
+ * @brief Run fn(0) .. fn(n - 1) in parallel, fn(0) on the calling thread.
+ */
+template <typename F>
+static void run_workers(int n, F fn) {
+    std::vector<std::thread> pool;
+    pool.reserve(n - 1);
+    for (int w = 1; w < n; ++w) pool.emplace_back(fn, w);
+    fn(0);
+    for (std::thread& t : pool) t.join();
+}
 
-            // Q update
-            q_update(Q, s, a, tr.r, tr.s2, tr.done, alpha, gamma);
+/**
+ * @brief Hogwild training: all workers learn into the shared table `Q`.
+ *
+ * Each worker owns its Engine and claims episode numbers from a shared
+ * counter. Q-table updates are lock-free: a worker may overwrite an update
+ * made to the same entry by another one, which costs little in practice
+ * since the workers rarely visit the same state at the same time.
+ */
+static void train_hogwild(QTable& Q, const TrainConfig& cfg, int n, TrainProgress& progress) {
+    std::atomic<int> next_episode{0};
+    const auto t0 = Clock::now();
+
+    run_workers(n, [&](int w) {
+        Engine env;
+        env.rng_engine = Rng::stream(cfg.seed, 2 * w);
+        rng = Rng::stream(cfg.seed, 2 * w + 1);
+
+        for (;;) {
+            if (progress.cancel.load(std::memory_order_relaxed)) break;
+            const int ep = next_episode.fetch_add(1, std::memory_order_relaxed);
+            if (ep >= cfg.episodes) break;
+            play_episode(Q, env, cfg, ep, progress, t0);
+        }
+    });
+}
 
-            // advance
-            s = tr.s2;
+/**
+ * @brief Private copy-on-write view of a QTable for one sharded worker.
+ *
+ * Reads fall through to `base` unless the shard wrote the state since the
+ * last merge; writes go to a small open-addressing overlay. A shard thus
+ * costs what its round played instead of a copy of every state. `base`
+ * must not change while the shard is in use (workers only read it).
+ */
+struct ShardTable {
+    const QTable* base = nullptr;  ///< Table the shard reads through to.
+    std::vector<uint32_t> slots;   ///< Entry + 1 per hash slot, 0 when free.
+    std::vector<uint32_t> states;  ///< State index of each entry, in first-write order.
+    std::vector<QValues> q;        ///< Q-values of each entry.
+    std::vector<uint32_t> visits;  ///< Updates of each entry since the last merge.
+    size_t fresh = 0;              ///< Entries for states `base` has never updated.
+
+    explicit ShardTable(const QTable& b) : base(&b) {}
+
+    size_t size() const { return base->size() + fresh; } ///< Number of states updated so far.
+
+    /// Entry holding state `idx`, or -1 if the shard never wrote it.
+    int find(uint32_t idx) const {
+        if (slots.empty()) return -1;
+        const size_t mask = slots.size() - 1;
+        for (size_t i = hash(idx) & mask;; i = (i + 1) & mask) {
+            if (slots[i] == 0) return -1;
+            if (states[slots[i] - 1] == idx) return (int)slots[i] - 1;
         }
-        best_len = std::max(best_len, (int)env.snake.size());
-        if (ep % 1000 == 0) {
-            printf("  Best snake length so far: %d\n", best_len);
+    }
+
+    QValues load(uint32_t idx) const {
+        const int e = find(idx);
+        return e >= 0 ? q[e] : base->load(idx);
+    }
+
+    int load(uint32_t idx, int a) const {
+        const int e = find(idx);
+        return e >= 0 ? q[e][a] : base->load(idx, a);
+    }
+
+    void store(uint32_t idx, int a, int value) { q[entry(idx)][a] = value; }
+
+    void visit(uint32_t idx) { ++visits[entry(idx)]; }
+
+    /// Forget every write, after a merge.
+    void clear() {
+        std::fill(slots.begin(), slots.end(), 0u);
+        states.clear();
+        q.clear();
+        visits.clear();
+        fresh = 0;
+    }
+
+private:
+    static size_t hash(uint32_t idx) { return (size_t)((idx * 0x9E3779B97F4A7C15ull) >> 32); } // Fibonacci hashing
+
+    /// Entry holding state `idx`, created from `base` on the first write.
+    uint32_t entry(uint32_t idx) {
+        const int e = find(idx);
+        if (e >= 0) return (uint32_t)e;
+        if (2 * (states.size() + 1) > slots.size()) grow();
+        const uint32_t n = (uint32_t)states.size();
+        states.push_back(idx);
+        q.push_back(base->load(idx));
+        visits.push_back(0);
+        fresh += base->visits[idx] == 0;
+        insert(n);
+        return n;
+    }
+
+    void insert(uint32_t e) {
+        const size_t mask = slots.size() - 1;
+        size_t i = hash(states[e]) & mask;
+        while (slots[i] != 0) i = (i + 1) & mask;
+        slots[i] = e + 1;
+    }
+
+    void grow() {
+        slots.assign(std::max<size_t>(1024, 2 * slots.size()), 0u);
+        for (uint32_t e = 0; e < states.size(); ++e) insert(e);
+    }
+};
+
+/**
+ * @brief Fold the shard updates of state `i` into `Q`.
+ *
+ * What a shard learned about a state is told by how many visits it added to
+ * it this round. The value becomes the average of the shard values weighted
+ * by those visits, which are then zeroed so the state is merged only once.
+ *
+ * @return 1 if `i` is new to `Q`, else 0.
+ */
+static size_t merge_state(QTable& Q, std::vector<ShardTable>& shards, uint32_t i) {
+    const uint32_t base = Q.visits[i];
+    uint32_t total = 0;
+    double sum[4] = {0, 0, 0, 0};
+    for (ShardTable& sh : shards) {
+        const int e = sh.find(i);
+        if (e < 0 || sh.visits[e] == 0) continue;
+        const uint32_t d = sh.visits[e];
+        sh.visits[e] = 0;
+        total += d;
+        for (int a = 0; a < 4; ++a) sum[a] += (double)d * sh.q[e][a];
+    }
+    if (total == 0) return 0;
+
+    for (int a = 0; a < 4; ++a) Q.q[i][a] = (int)(sum[a] / total);
+    Q.visits[i] = base + total;
+    return base == 0;
+}
+
+/**
+ * @brief Merge the states in [lo, hi) that any shard wrote this round.
+ *
+ * Only the shards' entries are walked, so a merge costs what the round
+ * played rather than a scan of every state. Workers merging disjoint
+ * ranges touch disjoint entries.
+ */
+static size_t merge_shards(QTable& Q, std::vector<ShardTable>& shards, uint32_t lo, uint32_t hi) {
+    size_t added = 0;
+    for (const ShardTable& sh : shards) {
+        for (size_t e = 0; e < sh.states.size(); ++e) {
+            const uint32_t i = sh.states[e];
+            if (i >= lo && i < hi && sh.visits[e] != 0) added += merge_state(Q, shards, i);
         }
+    }
+    return added;
+}
 
-        eps = eps == eps_end ? eps_end : eps * 0.995; // decay epsilon
+/**
+ * @brief Sharded training: every worker learns into a private ShardTable.
+ *
+ * Workers play rounds of `cfg.merge_every` episodes each with their own
+ * Engine and random generator, reading `Q` and writing their shard. Then
+ * the states the shards wrote are merged into `Q` and the shards are
+ * emptied. No table entry is shared while playing, and a run is
+ * reproducible for a given number of threads.
+ */
+static void train_sharded(QTable& Q, const TrainConfig& cfg, int n, TrainProgress& progress) {
+    const auto t0 = Clock::now();
+    const int k = cfg.merge_every;
+
+    std::vector<ShardTable> shards(n, ShardTable(Q));
+    std::vector<Engine> envs(n);
+    std::vector<Rng> rngs(n);
+    for (int w = 0; w < n; ++w) {
+        envs[w].rng_engine = Rng::stream(cfg.seed, 2 * w);
+        rngs[w] = Rng::stream(cfg.seed, 2 * w + 1);
+    }
+
+    for (int first = 0; first < cfg.episodes; first += n * k) {
+        if (progress.cancel.load(std::memory_order_relaxed)) break;
+
+        run_workers(n, [&](int w) {
+            rng = rngs[w]; // move_choice() draws from the thread's generator
+            const int lo = first + w * k;
+            const int hi = std::min(lo + k, cfg.episodes);
+            for (int ep = lo; ep < hi; ++ep) {
+                if (progress.cancel.load(std::memory_order_relaxed)) break;
+                play_episode(shards[w], envs[w], cfg, ep, progress, t0);
+            }
+            rngs[w] = rng;
+        });
+
+        std::vector<size_t> added(n, 0);
+        const size_t states = Q.capacity();
+        run_workers(n, [&](int w) {
+            added[w] = merge_shards(Q, shards, (uint32_t)(states * w / n), (uint32_t)(states * (w + 1) / n));
+        });
+        for (size_t a : added) Q.count += a;
+        for (ShardTable& sh : shards) sh.clear();
+        progress.qtable_size.store((long long)Q.size(), std::memory_order_relaxed);
     }
 }
 
+void train_logic(QTable& Q, const TrainConfig& cfg, TrainProgress& progress) {
+    const int n = std::max(1, cfg.threads);
+    if (cfg.merge_every > 0) {
+        train_sharded(Q, cfg, n, progress);
+    } else {
+        train_hogwild(Q, cfg, n, progress);
+    }
+}
 
-void Train::train() {
-    QTable Q;
 
+EvalResult evaluate(const QTable& Q, int grid, int games, uint64_t seed, TieBreak ties, int max_steps) {
+    EvalResult res{games, 0.0, 0, 0};
     Engine env;
-    int grid = 10;
+    env.rng_engine.seed(seed);
+    LoopDetector loops;
+    long long total = 0;
+    for (int g = 0; g < games; ++g) {
+        env.reset_board(grid);
+        loops.start(env);
+        State s = State::from_engine(env);
+        for (int steps = 0; !env.game_over && steps < max_steps; ++steps) {
+            bool random;
+            const StepInfo info = env.step(move_choice(Q, s, 0.0, ties, &random)); // no exploration
+            if (!info.done && loops.looped(env, info.ate_green || info.ate_red || random)) break;
+            s = State::from_engine(env);
+        }
+        const int len = (int)env.snake.size();
+        total += len;
+        res.max_length = std::max(res.max_length, len);
+        res.truncated += !env.game_over;
+    }
+    res.mean_length = games > 0 ? (double)total / games : 0.0;
+    return res;
+}
 
-    double alpha = 0.6, gamma = 0.85;
-    double eps0 = 0.9, epsf = 0.001;
 
-    train_logic(Q, 20000, alpha, gamma, eps0, epsf, env, grid);
+Train::~Train() {
+    cancel();
+    join();
+}
+
+void check_config(const TrainConfig& cfg) {
+    if (cfg.episodes < 0) throw std::runtime_error("episodes must be >= 0");
+    if (cfg.grid < 2) throw std::runtime_error("grid must be >= 2");
+    if (cfg.threads < 1 || cfg.threads > TrainConfig::MAX_THREADS) {
+        throw std::runtime_error("threads must be between 1 and " + std::to_string(TrainConfig::MAX_THREADS));
+    }
+    if (cfg.merge_every < 0) throw std::runtime_error("merge_every must be >= 0");
+}
+
+void Train::train() {
+    check_config(config);
+    if (progress.running.exchange(true)) {
+        throw std::runtime_error("a training run is already in progress");
+    }
+    set_error("");
+    reset_progress(config);
+    progress.cancel.store(false, std::memory_order_relaxed);
+    run(config);
+
+    std::lock_guard<std::mutex> guard(error_lock);
+    if (!error.empty()) throw std::runtime_error(error);
+}
+
+void Train::start() {
+    check_config(config);
+    if (progress.running.exchange(true)) {
+        throw std::runtime_error("a training run is already in progress");
+    }
+    join(); // reap a previous, already finished run
+    set_error("");
+    reset_progress(config); // before the thread exists, so the first poll() is already accurate
+    progress.cancel.store(false, std::memory_order_relaxed);
+    try {
+        worker = std::thread([this, cfg = config] { run(cfg); });
+    } catch (...) {
+        progress.running.store(false, std::memory_order_release);
+        throw;
+    }
+}
+
+void Train::set_error(const std::string& what) {
+    std::lock_guard<std::mutex> guard(error_lock);
+    error = what;
+}
 
+TrainStatus Train::poll() const {
+    return {
+        progress.episode.load(std::memory_order_relaxed),
+        progress.episodes.load(std::memory_order_relaxed),
+        progress.epsilon.load(std::memory_order_relaxed),
+        progress.best_length.load(std::memory_order_relaxed),
+        progress.steps.load(std::memory_order_relaxed),
+        progress.steps_per_sec.load(std::memory_order_relaxed),
+        progress.qtable_size.load(std::memory_order_relaxed),
+        progress.looped.load(std::memory_order_relaxed),
+        progress.running.load(std::memory_order_acquire),
+        progress.cancel.load(std::memory_order_relaxed),
+        [this] { std::lock_guard<std::mutex> guard(error_lock); return error; }(),
+    };
+}
+
+void Train::cancel() {
+    progress.cancel.store(true, std::memory_order_relaxed);
+}
+
+void Train::join() {
+    if (worker.joinable()) worker.join();
+}
+
+void Train::save(const std::string& path) const {
+    if (progress.running.load(std::memory_order_acquire)) {
+        throw std::runtime_error("cannot save while a training run is in progress");
+    }
+    ModelInfo info;
+    info.grid = config.grid;
+    info.episodes = config.episodes;
+    info.alpha = config.alpha;
+    info.gamma = config.gamma;
+    info.eps_start = config.eps_start;
+    info.eps_end = config.eps_end;
+    save_model(path, qtable, info);
+}
+
+void Train::load(const std::string& path) {
+    if (progress.running.load(std::memory_order_acquire)) {
+        throw std::runtime_error("cannot load while a training run is in progress");
+    }
+    const ModelInfo info = load_model(path, qtable);
+    config.grid = info.grid;
+    config.episodes = info.episodes;
+    config.alpha = info.alpha;
+    config.gamma = info.gamma;
+    config.eps_start = info.eps_start;
+    config.eps_end = info.eps_end;
+    progress.qtable_size.store((long long)qtable.size(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Play a few greedy games with `Q` and print their final lengths.
+ */
+static void test_runs(const QTable& Q, const TrainConfig& cfg, const TrainProgress& progress) {
+    Engine env;
+    env.rng_engine.seed(cfg.seed);
+    LoopDetector loops;
+    const int max_steps = 10000; // same safety cap as training
     for (int test_run = 0; test_run < 5; ++test_run) {
-        env.reset_board(grid);
-        State s = State(env.get_head_vision());
-        while (!env.game_over) {
-            int a = move_choice(Q, s, 0.0); // no exploration
-            apply_action(env, a);
-            env.step_forward(false);
-            s = State(env.get_head_vision());
+        if (progress.cancel.load(std::memory_order_relaxed)) break;
+        env.reset_board(cfg.grid);
+        loops.start(env);
+        State s = State::from_engine(env);
+        bool looped = false;
+        for (int steps = 0; !env.game_over && steps < max_steps
+                            && !progress.cancel.load(std::memory_order_relaxed); ++steps) {
+            bool random;
+            int a = move_choice(Q, s, 0.0, cfg.random_ties ? TIE_RANDOM : TIE_FIRST, &random); // no exploration
+            const StepInfo info = env.step(a);
+            if (!info.done && loops.looped(env, info.ate_green || info.ate_red || random)) { // the greedy policy cycles
+                looped = true;
+                break;
+            }
+            s = State::from_engine(env);
         }
         int len_snake = (int)env.snake.size();
-        printf("Training %d complete. Final snake length in test run: %d\n", test_run, len_snake);
+        if (!cfg.quiet) printf("Training %d complete. Final snake length in test run: %d%s\n", test_run, len_snake,
+                               looped ? " (stopped: loop)" : "");
     }
 }
+
+void Train::reset_progress(const TrainConfig& cfg) {
+    progress.episode.store(0, std::memory_order_relaxed);
+    progress.episodes.store(cfg.episodes, std::memory_order_relaxed);
+    progress.epsilon.store(cfg.eps_start, std::memory_order_relaxed);
+    progress.best_length.store(0, std::memory_order_relaxed);
+    progress.steps.store(0, std::memory_order_relaxed);
+    progress.steps_per_sec.store(0.0, std::memory_order_relaxed);
+    progress.qtable_size.store((long long)qtable.size(), std::memory_order_relaxed);
+    progress.looped.store(0, std::memory_order_relaxed);
+}
+
+void Train::run(TrainConfig cfg) {
+    QTable& Q = qtable;
+
+    // an exception must not escape: it would kill the process on the
+    // background thread and leave `running` set forever
+    try {
+        train_logic(Q, cfg, progress);
+        test_runs(Q, cfg, progress);
+    } catch (const std::exception& e) {
+        set_error(e.what());
+    } catch (...) {
+        set_error("unknown error");
+    }
+
+    progress.running.store(false, std::memory_order_release);
+}
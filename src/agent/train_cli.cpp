@@ -0,0 +1,267 @@
+/*!
+ *  @file train_cli.cpp
+ *  @brief Headless trainer: runs Train without Python and saves the model.
+ *
+ *  Built by `make` (see the Makefile) with L2S_HEADLESS, so it only needs a
+ *  C++17 compiler. Progress is printed on stdout as one JSON object per line:
+ *    {"event":"progress","episode":...,"episodes":...,"epsilon":...,...}
+ *    {"event":"done","cancelled":false,"model":"models/model1.bin",...}
+ *  "looped" counts the episodes ended early because the board repeated.
+ *  Errors go to stderr. SIGINT / SIGTERM stop the run early; the model
+ *  learned so far is still saved.
+ *
+ *  With --benchmark it instead times one reproducible run (greedy ties on the
+ *  lowest action, seed 42 unless given) and prints a single "benchmark" line
+ *  with steps/s, episodes/s, Q-table size, peak RSS and the score of a greedy
+ *  evaluation, so a change can be checked for speed and learning quality.
+ */
+
+#include "include/train.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+
+
+static volatile std::sig_atomic_t stop_requested = 0; ///< Set by the signal handler.
+
+static void on_signal(int) {
+    stop_requested = 1;
+}
+
+/**
+ * @brief Print the usage message to `out`.
+ */
+static void usage(FILE* out, const char* prog) {
+    fprintf(out,
+        "usage: %s [options]\n"
+        "  --episodes N       episodes to play (default 20000)\n"
+        "  --grid N           board size (default 10)\n"
+        "  --alpha X          learning rate (default 0.6)\n"
+        "  --gamma X          discount factor (default 0.85)\n"
+        "  --eps-start X      initial exploration rate (default 0.9)\n"
+        "  --eps-end X        exploration rate floor (default 0.001)\n"
+        "  --threads N        worker threads (default 1, at most 256)\n"
+        "  --merge-every K    private shards merged every K episodes (default 0: shared table)\n"
+        "  --seed N           random seed (default 42)\n"
+        "  --first-tie        break greedy ties on the lowest action instead of at random\n"
+        "  --loop-penalty X   reward of a move that repeats the board, ending the episode (default -100)\n"
+        "  --allow-loops      do not end episodes on a repeated board\n"
+        "  --load PATH        resume from a saved model\n"
+        "  --out PATH         where to save the model, directories are created (default models/model.bin)\n"
+        "  --interval MS      milliseconds between progress lines (default 1000)\n"
+        "  --benchmark        time one reproducible run instead, print one result line\n"
+        "  --eval-games N     greedy games scoring the --benchmark run (default 100)\n"
+        "  -h, --help         show this message\n",
+        prog);
+}
+
+/**
+ * @brief `s` as a quoted JSON string.
+ */
+static std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + '"';
+}
+
+/**
+ * @brief Print one progress line for `status`.
+ */
+static void print_status(const char* event, const TrainStatus& st) {
+    printf("{\"event\":\"%s\",\"episode\":%d,\"episodes\":%d,\"epsilon\":%.6f,"
+           "\"best_length\":%d,\"steps\":%lld,\"steps_per_sec\":%.1f,\"qtable_size\":%lld,\"looped\":%d",
+           event, st.episode, st.episodes, st.epsilon, st.best_length, st.steps,
+           st.steps_per_sec, st.qtable_size, st.looped);
+}
+
+/**
+ * @brief Peak resident set size of the process, in KiB.
+ */
+static long peak_rss_kb() {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#if defined(__APPLE__)
+    return ru.ru_maxrss / 1024; // bytes on macOS
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+/**
+ * @brief Make sure the model can be written to `path` before training.
+ *
+ * Creates the missing parent directories and test-opens the file, so a bad
+ * --out fails at once instead of after a long run.
+ *
+ * @throws std::runtime_error (or std::filesystem::filesystem_error).
+ */
+static void prepare_output(const std::string& path) {
+    const std::filesystem::path p(path);
+    if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path());
+    const bool existed = std::filesystem::exists(p);
+    FILE* f = fopen(path.c_str(), "ab");
+    if (!f) throw std::runtime_error("cannot open model file for writing: " + path);
+    fclose(f);
+    if (!existed) std::filesystem::remove(p); // no empty model left behind if the run dies
+}
+
+/**
+ * @brief Blocking timed run of train_logic() followed by a greedy evaluation.
+ */
+static int run_benchmark(TrainConfig cfg, int eval_games) {
+    cfg.random_ties = false;
+    QTable Q;
+    TrainProgress progress;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    train_logic(Q, cfg, progress);
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const EvalResult ev = evaluate(Q, cfg.grid, eval_games, cfg.seed + 1, TIE_FIRST);
+    const long long steps = progress.steps.load();
+    const int episodes = progress.episode.load();
+    printf("{\"event\":\"benchmark\",\"grid\":%d,\"episodes\":%d,\"threads\":%d,\"merge_every\":%d,"
+           "\"seed\":%llu,\"alpha\":%g,\"gamma\":%g,\"eps_start\":%g,\"eps_end\":%g,"
+           "\"seconds\":%.3f,\"steps\":%lld,\"steps_per_sec\":%.1f,\"episodes_per_sec\":%.1f,"
+           "\"qtable_size\":%zu,\"peak_rss_kb\":%ld,\"best_length\":%d,\"looped\":%d,"
+           "\"eval_games\":%d,\"eval_mean_length\":%.3f,\"eval_max_length\":%d,\"eval_truncated\":%d}\n",
+           cfg.grid, episodes, cfg.threads, cfg.merge_every, (unsigned long long)cfg.seed, cfg.alpha, cfg.gamma,
+           cfg.eps_start, cfg.eps_end, secs, steps, secs > 0 ? steps / secs : 0.0,
+           secs > 0 ? episodes / secs : 0.0, Q.size(), peak_rss_kb(), progress.best_length.load(),
+           progress.looped.load(),
+           ev.games, ev.mean_length, ev.max_length, ev.truncated);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Train trainer;
+    TrainConfig& cfg = trainer.config;
+    cfg.quiet = true;
+    std::string out = "models/model.bin";
+    std::string load;
+    int interval_ms = 1000;
+    bool benchmark = false;
+    int eval_games = 100;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            usage(stdout, argv[0]);
+            return 0;
+        }
+        if (arg == "--first-tie") {
+            cfg.random_ties = false;
+            continue;
+        }
+        if (arg == "--allow-loops") {
+            cfg.stop_loops = false;
+            continue;
+        }
+        if (arg == "--benchmark") {
+            benchmark = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "error: unknown option or missing value: %s\n", arg.c_str());
+            usage(stderr, argv[0]);
+            return 2;
+        }
+        const char* val = argv[++i];
+        char* end = nullptr;
+        if (arg == "--episodes") cfg.episodes = (int)strtol(val, &end, 10);
+        else if (arg == "--grid") cfg.grid = (int)strtol(val, &end, 10);
+        else if (arg == "--alpha") cfg.alpha = strtod(val, &end);
+        else if (arg == "--gamma") cfg.gamma = strtod(val, &end);
+        else if (arg == "--eps-start") cfg.eps_start = strtod(val, &end);
+        else if (arg == "--eps-end") cfg.eps_end = strtod(val, &end);
+        else if (arg == "--threads") cfg.threads = (int)strtol(val, &end, 10);
+        else if (arg == "--merge-every") cfg.merge_every = (int)strtol(val, &end, 10);
+        else if (arg == "--loop-penalty") cfg.loop_penalty = strtod(val, &end);
+        else if (arg == "--seed") cfg.seed = strtoull(val, &end, 10);
+        else if (arg == "--interval") interval_ms = (int)strtol(val, &end, 10);
+        else if (arg == "--eval-games") eval_games = (int)strtol(val, &end, 10);
+        else if (arg == "--out") { out = val; continue; }
+        else if (arg == "--load") { load = val; continue; }
+        else {
+            fprintf(stderr, "error: unknown option: %s\n", arg.c_str());
+            usage(stderr, argv[0]);
+            return 2;
+        }
+        if (end == val || *end != '\0') {
+            fprintf(stderr, "error: invalid value for %s: %s\n", arg.c_str(), val);
+            return 2;
+        }
+    }
+    if (interval_ms < 1 || eval_games < 0) {
+        fprintf(stderr, "error: --interval must be >= 1 and --eval-games >= 0\n");
+        return 2;
+    }
+    try {
+        check_config(cfg);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 2;
+    }
+    if (benchmark) return run_benchmark(cfg, eval_games);
+
+    try {
+        if (!load.empty()) {
+            // keep the command line settings, only take the Q-table from the file
+            const TrainConfig keep = cfg;
+            trainer.load(load);
+            cfg = keep;
+        }
+        prepare_output(out);
+
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+
+        trainer.start();
+        auto next = std::chrono::steady_clock::now();
+        while (trainer.poll().running) {
+            if (stop_requested) trainer.cancel();
+            if (std::chrono::steady_clock::now() >= next) {
+                print_status("progress", trainer.poll());
+                printf("}\n");
+                fflush(stdout);
+                next += std::chrono::milliseconds(interval_ms);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(interval_ms, 50)));
+        }
+        trainer.join();
+
+        const TrainStatus st = trainer.poll();
+        if (!st.error.empty()) { // keep any previous model rather than a partial one
+            fprintf(stderr, "error: training failed: %s\n", st.error.c_str());
+            return 1;
+        }
+        trainer.save(out);
+        print_status("done", st);
+        printf(",\"cancelled\":%s,\"model\":%s}\n", st.cancelled ? "true" : "false", json_string(out).c_str());
+        fflush(stdout);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*!
+ *  @file vec_engine.cpp
+ *  @brief Batched engine stepping N boards per call.
+ */
+
+#include "include/vec_engine.hpp"
+#include <cstddef>
+#include <cstring>
+
+
+VecEngine::VecEngine(int n, int grid, uint64_t seed)
+    : n(n), grid(grid), envs(n),
+      results(n, MOVE_RESULT::MOVE_OK), rewards(n, 0.0f), dones(n, 0),
+      lengths(n, 0), sensors((size_t)n * SENSOR_COUNT, 0), episodes(n, 0),
+      green_dist(n, 0) {
+    Rng stream(seed);
+    for (int i = 0; i < n; ++i) {
+        envs[i].rng_engine = stream;
+        stream.jump();
+    }
+    reset();
+}
+
+void VecEngine::reset() {
+    for (int i = 0; i < n; ++i) {
+        envs[i].reset_board(grid);
+        results[i] = MOVE_RESULT::MOVE_OK;
+        rewards[i] = 0.0f;
+        dones[i] = 0;
+        lengths[i] = envs[i].snake.size();
+        write_sensors(i);
+    }
+}
+
+void VecEngine::write_sensors(int i) {
+    Sensors s = envs[i].sense();
+    static_assert(sizeof(Sensors) == SENSOR_COUNT, "Sensors must be packed bytes");
+    std::memcpy(&sensors[(size_t)i * SENSOR_COUNT], &s, SENSOR_COUNT);
+    green_dist[i] = State(s).nearest_green_dist;
+}
+
+void VecEngine::step(const int* actions) {
+    for (int i = 0; i < n; ++i) {
+        Engine& env = envs[i];
+        const int before = green_dist[i];
+
+        const StepInfo info = env.step(actions[i]);
+        const MOVE_RESULT res = info.result;
+
+        results[i] = res;
+        dones[i] = info.done;
+        lengths[i] = info.length;
+        if (info.done) {
+            ++episodes[i];
+            env.reset_board(grid);
+        }
+        write_sensors(i);
+
+        // same shaping as the trainer (see Rewards::of)
+        const double r = rewards_table.of(res, before, green_dist[i]);
+        rewards[i] = (float)r;
+    }
+}
@@ -10,7 +10,7 @@ Dependencies:
 
 import pygame
 from pathlib import Path
-from render import load_images, draw_board, CELL, game_over_screen, home_menu, pause_menu, settings_screen
+from render import load_images, draw_board, CELL, game_over_screen, home_menu, pause_menu, settings_screen, training_screen
 import agent
 
 def game_loop(screen, grid_size=10, assets_path=Path("./assets")):
@@ -143,7 +143,21 @@ def main():
         if choice == "play":
             running = game_loop(screen, grid_size=current_grid, assets_path=assets_path)
         elif choice == "ai":
-            trainer.train()
+            model_file = models_path / f"{current_model}.bin"
+            if model_file.is_file():
+                try:
+                    trainer.load(str(model_file))  # resume from the selected model
+                except RuntimeError as err:
+                    # stale (other State version) or damaged file: start over
+                    print(f"Cannot load {model_file}: {err}. Training from scratch.")
+                    trainer = agent.Train()
+            trainer.start()
+            result = training_screen(screen, trainer)
+            if result == "done":
+                models_path.mkdir(parents=True, exist_ok=True)
+                trainer.save(str(model_file))
+            elif result == "quit":
+                running = False
         elif choice == "settings":
             choice, grid_size, model = settings_screen(screen, grid_size=current_grid, model_name=current_model, models_dir=models_path)
             if choice == "save":
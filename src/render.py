@@ -1,6 +1,6 @@
 """
 This script handles the rendering of a snake game using Pygame. It includes functions for loading images,
-drawing the game board, displaying menus (home, pause, game over, settings, ...), and creating UI elements like sliders and list boxes.
+drawing the game board, displaying menus (home, pause, game over, settings, training, ...), and creating UI elements like sliders and list boxes.
 
 Dependencies:
     - os
@@ -548,6 +548,96 @@ def pause_menu(screen, *, bg_surface=None, bg_dim=140):
         pygame.display.flip()
 
 
+def training_screen(screen, trainer, *, bg_color=(18, 20, 24)):
+    """
+    Draws Training progress screen while `trainer` runs in the background.
+    Polls the trainer every frame and blocks until the run ends or is cancelled.
+    Returns: 'done', 'cancelled', 'failed', or 'quit'.
+    Keys: Esc/Q -> cancel.
+
+    @param screen: Pygame display surface
+    @param trainer: agent.Train instance with a run started via trainer.start()
+    @param bg_color: Background color of the screen
+
+    @return: Outcome as a string
+    """
+    w, h = screen.get_size()
+    clock = pygame.time.Clock()
+    title_f = pygame.font.SysFont(None, 56, bold=True)
+    sub_f = pygame.font.SysFont(None, 22)
+    stat_f = pygame.font.SysFont(None, 30)
+    btn_f = pygame.font.SysFont(None, 32)
+
+    panel_w, panel_h = min(760, int(w * 0.9)), min(400, int(h * 0.8))
+    panel = pygame.Rect((w - panel_w) // 2, (h - panel_h) // 2, panel_w, panel_h)
+
+    bar = pygame.Rect(panel.left + 40, panel.top + 110, panel_w - 80, 22)
+    bw, bh = 220, 56
+    btn_cancel = pygame.Rect(w // 2 - bw // 2, panel.bottom - bh - 24, bw, bh)
+
+    pulser = 0.0
+
+    while True:
+        dt = clock.tick(60) / 1000.0
+        pulser += dt
+
+        status = trainer.poll()
+        if not status.running:
+            trainer.join()
+            if status.error:
+                print(f"Training failed: {status.error}")
+                return "failed"
+            return "cancelled" if status.cancelled else "done"
+
+        cancel = False
+        for e in pygame.event.get([pygame.QUIT, pygame.KEYDOWN]):
+            if e.type == pygame.QUIT:
+                trainer.cancel()
+                trainer.join()
+                return "quit"
+            if e.type == pygame.KEYDOWN and e.key in (pygame.K_ESCAPE, pygame.K_q):
+                cancel = True
+
+        screen.fill(bg_color)
+
+        # panel
+        _draw_shadow(screen, panel, radius=22, offset=(0, 10), blur=14, alpha=150)
+        _draw_round_rect(screen, panel, (28, 32, 38), radius=22)
+
+        # title + hint
+        title = title_f.render("Training", True, (240, 244, 248))
+        screen.blit(title, title.get_rect(midtop=(w // 2, panel.top + 22)))
+        pulse = 0.6 + 0.4 * (0.5 + 0.5 * math.sin(pulser * 4.0))
+        hint = sub_f.render("Esc/Q: Cancel", True,
+                            (int(200 * pulse), int(210 * pulse), int(220 * pulse)))
+        screen.blit(hint, hint.get_rect(midtop=(w // 2, panel.top + 22 + 46)))
+
+        # progress bar
+        frac = status.episode / status.episodes if status.episodes else 0.0
+        _draw_round_rect(screen, bar, (45, 50, 58), radius=11)
+        if frac > 0:
+            fill = pygame.Rect(bar.left, bar.top, max(bar.height, int(bar.width * frac)), bar.height)
+            _draw_round_rect(screen, fill, (86, 156, 255), radius=11)
+
+        # counters
+        lines = [
+            f"Episode {status.episode} / {status.episodes}",
+            f"Epsilon {status.epsilon:.4f} - Best length {status.best_length} - Loops cut {status.looped:,}",
+            f"{status.steps_per_sec:,.0f} steps/s - Q-table {status.qtable_size:,} states",
+        ]
+        y = bar.bottom + 22
+        for line in lines:
+            txt = stat_f.render(line, True, (220, 225, 232))
+            screen.blit(txt, txt.get_rect(midtop=(w // 2, y)))
+            y += 34
+
+        _, clicked_cancel = _button(screen, btn_cancel, "Cancel", btn_f)
+        if cancel or clicked_cancel:
+            trainer.cancel()
+
+        pygame.display.flip()
+
+
 class Slider:
     """
     A horizontal slider widget.
@@ -790,7 +880,7 @@ class ListBox:
 # ---------- utilities ----------
 def _scan_models(models_dir):
     """
-    Scan the models directory for available model files (.txt).
+    Scan the models directory for available model files (.bin).
     Returns a sorted list of model names (file stems).
 
     @param models_dir: Directory to scan for model files
@@ -800,7 +890,7 @@ def _scan_models(models_dir):
     names = []
     try:
         for fn in os.listdir(models_dir):
-            if fn.lower().endswith(".txt"):
+            if fn.lower().endswith(".bin"):
                 names.append(os.path.splitext(fn)[0])  # stem as model name
     except FileNotFoundError:
         pass